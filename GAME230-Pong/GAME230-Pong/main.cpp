@@ -10,6 +10,19 @@
 #include<cmath>
 #include<iostream>
 #include<string>
+#include<thread>
+#include<atomic>
+#include<memory>
+#include<mutex>
+#include<condition_variable>
+#include<fstream>
+#include<cstdint>
+#include<cstring>
+#include<algorithm>
+#include<ctime>
+#include<sstream>
+#include<functional>
+#include<chrono>
 
 using namespace std;
 using namespace sf;
@@ -22,876 +35,5838 @@ const int WINDOW_HEIGHT = 512;
 const double PI = 3.14159265358979323846264388;
 
 /*
-Powerup class for SFML Pong
-Draws a circle on the screen and keeps track of whether the powerup is collected or not.
+Asset loader class for SFML Pong
+Decodes sounds, fonts, images and music on worker threads so the window can show a loading screen right away.
+Decoded images are uploaded as textures on the render thread in update(), since textures need the window's GL context.
+Failed optional assets are left empty, so sounds stay silent and sprites draw nothing instead of exiting the game.
 */
+const int MAX_ASSETS = 16;
 
-class PowerUp {
+enum AssetType { ASSET_SOUND, ASSET_FONT, ASSET_TEXTURE, ASSET_MUSIC };
+enum AssetState { ASSET_PENDING, ASSET_DECODED, ASSET_READY, ASSET_FAILED };
+
+struct Asset {
+	AssetType type;
+	string filename;
+	bool optional;
+	bool reported; // failure already printed (render thread only)
+	atomic<int> state;
+	SoundBuffer soundBuffer;
+	Font font;
+	Image image;
+	Texture texture;
+	unique_ptr<Music> music; // only created for music assets, music sources are heavy
+};
+
+class AssetLoader {
 public:
-	PowerUp(Vector2f position);
-	void draw(RenderWindow* window);
-	Vector2f getPosition();
-	float getRadius();
-	void collect(bool state);
-	bool isCollected();
+	AssetLoader();
+	~AssetLoader();
+	int add(AssetType type, string filename, bool optional);
+	void start();
+	void update();
+	bool isDone();
+	bool isReady(int id);
+	float getProgress();
+	string getFailedRequired();
+	SoundBuffer& getSoundBuffer(int id);
+	Font& getFont(int id);
+	Texture& getTexture(int id);
+	Music* getMusic(int id);
 private:
-	CircleShape shape;
-	Vector2f position;
-	float radius;
-	bool collected;
+	void work();
+	void decode(Asset* asset);
+	Asset assets[MAX_ASSETS];
+	int count;
+	atomic<int> nextJob;
+	vector<thread> workers;
 };
 
-PowerUp::PowerUp(Vector2f position) {
-	this->position = position;
-	this->radius = 10.0f;
-	this->collected = false;
-	this->shape = CircleShape(this->radius);
-	this->shape.setFillColor(Color(200, 0, 255));
+AssetLoader::AssetLoader() {
+	this->count = 0;
+	this->nextJob = 0;
 }
 
-void PowerUp::collect(bool state) {
-	this->collected = state;
+AssetLoader::~AssetLoader() {
+	// workers only ever finish their current file, so this wait is bounded
+	for (size_t i = 0; i < this->workers.size(); i++) {
+		this->workers[i].join();
+	}
 }
 
-bool PowerUp::isCollected() {
-	return this->collected;
+int AssetLoader::add(AssetType type, string filename, bool optional) {
+	// queue an asset, must be called before start()
+	if (this->count >= MAX_ASSETS || !this->workers.empty()) {
+		return -1;
+	}
+	Asset* asset = &this->assets[this->count];
+	asset->type = type;
+	asset->filename = filename;
+	asset->optional = optional;
+	asset->reported = false;
+	asset->state = ASSET_PENDING;
+	if (type == ASSET_MUSIC) {
+		asset->music.reset(new Music());
+	}
+	return this->count++;
 }
 
-Vector2f PowerUp::getPosition() {
-	return this->position;
+void AssetLoader::start() {
+	// one worker per core, but never more workers than files
+	int threadCount = (int)thread::hardware_concurrency();
+	if (threadCount < 1) {
+		threadCount = 1;
+	}
+	if (threadCount > this->count) {
+		threadCount = this->count;
+	}
+	for (int i = 0; i < threadCount; i++) {
+		this->workers.push_back(thread(&AssetLoader::work, this));
+	}
 }
 
-float PowerUp::getRadius() {
-	return this->radius;
+void AssetLoader::work() {
+	// pull assets off the shared queue until it is empty
+	int job = this->nextJob++;
+	while (job < this->count) {
+		this->decode(&this->assets[job]);
+		job = this->nextJob++;
+	}
 }
 
-void PowerUp::draw(RenderWindow* window) {
-	// correct for top-left shape origin
-	this->shape.setPosition(Vector2f(this->position.x - this->radius, this->position.y - this->radius));
-	window->draw(this->shape);
+void AssetLoader::decode(Asset* asset) {
+	bool loaded = false;
+	if (asset->type == ASSET_SOUND) {
+		loaded = asset->soundBuffer.loadFromFile(asset->filename);
+	}
+	else if (asset->type == ASSET_FONT) {
+		loaded = asset->font.loadFromFile(asset->filename);
+	}
+	else if (asset->type == ASSET_TEXTURE) {
+		loaded = asset->image.loadFromFile(asset->filename);
+	}
+	else if (asset->type == ASSET_MUSIC) {
+		loaded = asset->music->openFromFile(asset->filename);
+	}
+
+	if (!loaded) {
+		asset->state = ASSET_FAILED;
+	}
+	else if (asset->type == ASSET_TEXTURE) {
+		asset->state = ASSET_DECODED; // still needs upload on the render thread
+	}
+	else {
+		asset->state = ASSET_READY;
+	}
 }
 
-/*
-Scoreboard class for SFML Pong
-Represents the current score on screen
-*/
-class Scoreboard {
-public:
-	Scoreboard(Vector2f position);
-	void draw(RenderWindow* window);
-	void update(int scoreRight, int scoreleft);
-	void reset();
-	Vector2f getScores();
-private:
-	int leftScore;
-	int rightScore;
-	Text leftScoreText;
-	Text rightScoreText;
-	Vector2f positionLeft;
-	Vector2f positionRight;
-	Font font;
-};
+void AssetLoader::update() {
+	// render thread: upload decoded images and report missing files
+	for (int i = 0; i < this->count; i++) {
+		Asset* asset = &this->assets[i];
+		if (asset->state == ASSET_DECODED) {
+			if (asset->texture.loadFromImage(asset->image)) {
+				asset->state = ASSET_READY;
+			}
+			else {
+				asset->state = ASSET_FAILED;
+			}
+		}
+		if (asset->state == ASSET_FAILED && !asset->reported) {
+			asset->reported = true;
+			if (asset->optional) {
+				cerr << "Optional asset " << asset->filename << " could not be loaded, continuing without it" << endl;
+			}
+			else {
+				cerr << "Required asset " << asset->filename << " could not be loaded" << endl;
+			}
+		}
+	}
+}
+
+bool AssetLoader::isDone() {
+	for (int i = 0; i < this->count; i++) {
+		int state = this->assets[i].state;
+		if (state != ASSET_READY && state != ASSET_FAILED) {
+			return false;
+		}
+	}
+	return true;
+}
 
-Scoreboard::Scoreboard(Vector2f position) {
-	this->leftScore = 0;
-	this->rightScore = 0;
+bool AssetLoader::isReady(int id) {
+	return id >= 0 && id < this->count && this->assets[id].state == ASSET_READY;
+}
 
-	sf::Font fontLoader;
-	if (!fontLoader.loadFromFile("arial.ttf"))
-	{
-		std::exit(-1);
+float AssetLoader::getProgress() {
+	if (this->count == 0) {
+		return 1.0f;
+	}
+	int finished = 0;
+	for (int i = 0; i < this->count; i++) {
+		int state = this->assets[i].state;
+		if (state == ASSET_READY || state == ASSET_FAILED) {
+			finished++;
+		}
 	}
+	return (float)finished / (float)this->count;
+}
 
-	this->font = fontLoader;
-	this->leftScoreText = Text("0", this->font, 30);
-	this->leftScoreText.setFillColor(sf::Color::White);
-	this->leftScoreText.setStyle(sf::Text::Bold);
-	this->rightScoreText = this->leftScoreText;
-	this->leftScoreText.setPosition(Vector2f(position.x - 100.0f, position.y));
-	this->rightScoreText.setPosition(Vector2f(position.x + 80.0f, position.y));
+string AssetLoader::getFailedRequired() {
+	// returns the first required file that failed, or an empty string
+	for (int i = 0; i < this->count; i++) {
+		if (!this->assets[i].optional && this->assets[i].state == ASSET_FAILED) {
+			return this->assets[i].filename;
+		}
+	}
+	return "";
 }
 
-Vector2f Scoreboard::getScores() {
-	return Vector2f(this->leftScore, this->rightScore);
+// the getters below hand back empty objects for failed assets so callers degrade quietly
+SoundBuffer& AssetLoader::getSoundBuffer(int id) {
+	return this->assets[id].soundBuffer;
 }
 
-void Scoreboard::draw(RenderWindow* window) {
-	// set strings to reflect score
-	this->leftScoreText.setString(to_string(this->leftScore));
-	this->rightScoreText.setString(to_string(this->rightScore));
-	// draw strings
-	window->draw(this->leftScoreText);
-	window->draw(this->rightScoreText);
+Font& AssetLoader::getFont(int id) {
+	return this->assets[id].font;
 }
 
-void Scoreboard::update(int scoreLeft, int scoreRight) {
-	// update score ints
-	this->leftScore += scoreLeft;
-	this->rightScore += scoreRight;
+Texture& AssetLoader::getTexture(int id) {
+	return this->assets[id].texture;
 }
 
-void Scoreboard::reset() {
-	// update score ints
-	this->leftScore = 0;
-	this->rightScore = 0;
+Music* AssetLoader::getMusic(int id) {
+	if (!this->isReady(id)) {
+		return nullptr;
+	}
+	return this->assets[id].music.get();
 }
 
 /*
-Paddle class for SFML Pong
-Represents the paddles on screen, takes input from the keyboard, and provides movement for AI player(s)
+Canvas classes for SFML Pong
+Everything the game draws goes through a Canvas. TargetCanvas hands shapes to an SFML window or render texture, and
+SoftwareCanvas rasterizes them on the CPU into a framebuffer of any size, so rendering works on machines with no
+display or GPU. Software frames are recorded as a command list and rasterized by a pool of threads, one horizontal
+band each. Every band replays the same commands in order, so the image doesn't depend on the thread count.
+Text uses a built-in 5x7 pixel font there, since SFML fonts only rasterize into GPU textures. For the same reason it
+can't sample a Sprite's texture, backgrounds are drawn from an Image with drawImage instead. Creating any SFML texture
+opens a GL context, so nothing that draws only into a SoftwareCanvas should own one.
 */
-class Paddle {
+class Canvas {
 public:
-	Paddle(Vector2f position);
-	Vector2f getPosition();
-	Vector2f getSize();
-	void setAi(bool toSet);
-	void draw(RenderWindow* window);
-	void setPosition(Vector2f np);
-	void setVelocityPlayer(float dt, bool down, bool up);
-	void setVelocityAi(float dt, Vector2f bp);
-	void updateDelegator(float dt, bool down, bool up, Vector2f bp);
+	virtual ~Canvas() {}
+	virtual void clear(Color color) = 0;
+	virtual void draw(const RectangleShape& shape) = 0;
+	virtual void draw(const CircleShape& shape) = 0;
+	virtual void draw(const Sprite& sprite) = 0;
+	virtual void draw(const Text& text) = 0;
+};
+
+class TargetCanvas : public Canvas {
+public:
+	TargetCanvas(RenderTarget* target);
+	void clear(Color color);
+	void draw(const RectangleShape& shape);
+	void draw(const CircleShape& shape);
+	void draw(const Sprite& sprite);
+	void draw(const Text& text);
 private:
-	float velocity_y;
-	Vector2f position;
-	RectangleShape shape;
-	float height;
-	float baseVelocity;
-	bool ai;
+	RenderTarget* target;
 };
 
-Paddle::Paddle(Vector2f position) {
-	// set up shape
-	this->height = 70.0f;
-	this->shape = RectangleShape(Vector2f(10.0f, this->height));
-	this->position = position;
-	this->velocity_y = 0.0f;
-	this->baseVelocity = 0.4f;
-	// if ai player or not
-	this->ai = false;
+TargetCanvas::TargetCanvas(RenderTarget* target) {
+	this->target = target;
 }
 
-void Paddle::setPosition(Vector2f np) {
-	this->position = np;
+void TargetCanvas::clear(Color color) {
+	this->target->clear(color);
 }
 
-void Paddle::setAi(bool state) {
-	this->ai = state;
+void TargetCanvas::draw(const RectangleShape& shape) {
+	this->target->draw(shape);
 }
 
-Vector2f Paddle::getPosition() {
-	return this->position;
+void TargetCanvas::draw(const CircleShape& shape) {
+	this->target->draw(shape);
 }
 
-Vector2f Paddle::getSize() {
-	return this->shape.getSize();
+void TargetCanvas::draw(const Sprite& sprite) {
+	this->target->draw(sprite);
+}
+
+void TargetCanvas::draw(const Text& text) {
+	this->target->draw(text);
+}
+
+const int CANVAS_MAX_THREADS = 16;
+const unsigned CANVAS_MAX_SIZE = 16384; // per side, 1 GB of RGBA at the most
+const int CANVAS_FONT_FIRST = 32; // font covers ' ' to '~'
+const int CANVAS_FONT_COUNT = 95;
+
+// 5x7 glyphs, one byte per column, lowest bit on top
+const uint8_t CANVAS_FONT[CANVAS_FONT_COUNT][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },
+	{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+	{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+	{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+	{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+	{ 0x00, 0x08, 0x14, 0x22, 0x41 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x41, 0x22, 0x14, 0x08, 0x00 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+	{ 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+	{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x01, 0x01 }, { 0x3E, 0x41, 0x41, 0x51, 0x32 },
+	{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+	{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x04, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+	{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F }, { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F },
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x00, 0x7F, 0x41, 0x41 },
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x41, 0x41, 0x7F, 0x00, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+	{ 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+	{ 0x38, 0x44, 0x44, 0x48, 0x7F }, { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x08, 0x14, 0x54, 0x54, 0x3C },
+	{ 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3D, 0x00 }, { 0x00, 0x7F, 0x10, 0x28, 0x44 },
+	{ 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 }, { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+	{ 0x7C, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7C }, { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+	{ 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C }, { 0x1C, 0x20, 0x40, 0x20, 0x1C }, { 0x3C, 0x40, 0x30, 0x40, 0x3C },
+	{ 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C }, { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+	{ 0x00, 0x00, 0x7F, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 }
+};
+
+enum CanvasCommandType {
+	CANVAS_RECTANGLE,
+	CANVAS_CIRCLE,
+	CANVAS_SPRITE,
+	CANVAS_TEXT
+};
+
+struct CanvasCommand {
+	CanvasCommandType type;
+	Color color;
+	float toLocal[6]; // framebuffer pixel to shape coordinates, 2x3 affine
+	float bounds[4]; // framebuffer pixels covered, left top right bottom
+	float width; // shape size in its own coordinates
+	float height;
+	const Image* image; // sprites
+	IntRect textureRect;
+	int textStart; // text, in the frame's character arena
+	int textLength;
+	float textPixel; // size of one font pixel in text coordinates
+};
+
+class SoftwareCanvas : public Canvas {
+public:
+	SoftwareCanvas(unsigned width, unsigned height, int threads);
+	~SoftwareCanvas();
+	void clear(Color color);
+	void draw(const RectangleShape& shape);
+	void draw(const CircleShape& shape);
+	void draw(const Sprite& sprite);
+	void draw(const Text& text);
+	void drawImage(const Image& image);
+	void display();
+	const uint8_t* getPixels();
+	unsigned getWidth();
+	unsigned getHeight();
+	int getThreads();
+	uint64_t getChecksum();
+	bool save(string filename);
+private:
+	void add(CanvasCommand& command, const Transformable& shape, float width, float height);
+	void rasterize(int band);
+	void work(int band);
+	unsigned width;
+	unsigned height;
+	float scaleX; // game coordinates to framebuffer pixels
+	float scaleY;
+	vector<uint8_t> pixels; // RGBA, top row first
+	Color clearColor;
+	vector<CanvasCommand> commands;
+	vector<char> text; // characters of this frame's text commands
+
+	// band workers, the caller rasterizes band 0
+	int threads;
+	vector<thread> workers;
+	mutex lock;
+	condition_variable wake;
+	condition_variable done;
+	uint32_t frame;
+	int finished;
+	bool stopping;
+};
+
+SoftwareCanvas::SoftwareCanvas(unsigned width, unsigned height, int threads) {
+	width = max(1u, min(CANVAS_MAX_SIZE, width));
+	height = max(1u, min(CANVAS_MAX_SIZE, height));
+	this->width = width;
+	this->height = height;
+	this->scaleX = (float)width / WINDOW_WIDTH;
+	this->scaleY = (float)height / WINDOW_HEIGHT;
+	this->pixels.assign((size_t)width * height * 4, 0);
+	this->clearColor = Color::Black;
+	this->commands.reserve(1024);
+	this->text.reserve(1024);
+
+	// 0 picks one band per core, never more bands than rows
+	if (threads <= 0) {
+		threads = (int)thread::hardware_concurrency();
+	}
+	this->threads = max(1, min(min(threads, CANVAS_MAX_THREADS), (int)height));
+	this->frame = 0;
+	this->finished = 0;
+	this->stopping = false;
+	for (int i = 1; i < this->threads; i++) {
+		this->workers.push_back(thread(&SoftwareCanvas::work, this, i));
+	}
 }
 
-// delegates to player OR AI function and then updates
-void Paddle::updateDelegator(float dt, bool down, bool up, Vector2f bp) { 
-	if (this->ai) { // if this is an AI paddle
-		setVelocityAi(dt, bp);
+SoftwareCanvas::~SoftwareCanvas() {
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->stopping = true;
 	}
-	else { // this is a player paddle
-		setVelocityPlayer(dt, down, up);
+	this->wake.notify_all();
+	for (size_t i = 0; i < this->workers.size(); i++) {
+		this->workers[i].join();
 	}
+}
 
-	// update position based on velocity
-	this->position.y += this->velocity_y * dt;
+void SoftwareCanvas::clear(Color color) {
+	this->clearColor = color;
+	this->commands.clear();
+	this->text.clear();
+}
 
-	// check y bounds (keep paddle on screen)
-	if (this->position.y + this->height > WINDOW_HEIGHT) {
-		this->position.y = WINDOW_HEIGHT - this->height;
+void SoftwareCanvas::add(CanvasCommand& command, const Transformable& shape, float width, float height) {
+	// SFML's transform is translate(position) rotate scale translate(-origin), then the game view scales to pixels
+	float angle = shape.getRotation() * (float)PI / 180.0f;
+	float c = cos(angle);
+	float s = sin(angle);
+	Vector2f scale = shape.getScale();
+	Vector2f origin = shape.getOrigin();
+	Vector2f position = shape.getPosition();
+	float a = c * scale.x * this->scaleX;
+	float b = -s * scale.y * this->scaleX;
+	float d = s * scale.x * this->scaleY;
+	float e = c * scale.y * this->scaleY;
+	float tx = (position.x - (c * scale.x * origin.x - s * scale.y * origin.y)) * this->scaleX;
+	float ty = (position.y - (s * scale.x * origin.x + c * scale.y * origin.y)) * this->scaleY;
+
+	float det = a * e - b * d;
+	if (det == 0.0f) {
+		return;
 	}
-	else if (this->position.y < 0) {
-		this->position.y = 0;
+	command.toLocal[0] = e / det;
+	command.toLocal[1] = -b / det;
+	command.toLocal[2] = (b * ty - e * tx) / det;
+	command.toLocal[3] = -d / det;
+	command.toLocal[4] = a / det;
+	command.toLocal[5] = (d * tx - a * ty) / det;
+
+	float xs[4] = { tx, tx + a * width, tx + b * height, tx + a * width + b * height };
+	float ys[4] = { ty, ty + d * width, ty + e * height, ty + d * width + e * height };
+	command.bounds[0] = min(min(xs[0], xs[1]), min(xs[2], xs[3]));
+	command.bounds[1] = min(min(ys[0], ys[1]), min(ys[2], ys[3]));
+	command.bounds[2] = max(max(xs[0], xs[1]), max(xs[2], xs[3]));
+	command.bounds[3] = max(max(ys[0], ys[1]), max(ys[2], ys[3]));
+	command.width = width;
+	command.height = height;
+	this->commands.push_back(command);
+}
+
+void SoftwareCanvas::draw(const RectangleShape& shape) {
+	CanvasCommand command;
+	command.type = CANVAS_RECTANGLE;
+	command.color = shape.getFillColor();
+	this->add(command, shape, shape.getSize().x, shape.getSize().y);
+}
+
+void SoftwareCanvas::draw(const CircleShape& shape) {
+	CanvasCommand command;
+	command.type = CANVAS_CIRCLE;
+	command.color = shape.getFillColor();
+	this->add(command, shape, shape.getRadius() * 2.0f, shape.getRadius() * 2.0f);
+}
+
+void SoftwareCanvas::draw(const Sprite&) {
+	// the texture's pixels are on the GPU, there is nothing here to sample
+}
+
+void SoftwareCanvas::drawImage(const Image& image) {
+	// whole image at the game's origin, the way the scenes place their background sprites
+	if (image.getSize().x == 0 || image.getSize().y == 0) {
+		return;
 	}
+	Sprite placement;
+	CanvasCommand command;
+	command.type = CANVAS_SPRITE;
+	command.color = Color::White;
+	command.image = &image;
+	command.textureRect = IntRect(0, 0, image.getSize().x, image.getSize().y);
+	this->add(command, placement, (float)command.textureRect.width, (float)command.textureRect.height);
 }
 
-void Paddle::setVelocityAi(float dt, Vector2f bp) {
-	// sets the paddle velocity based on y-tracking the ball
-	float distanceToBall = abs(this->position.x - bp.x);
-	if (distanceToBall < WINDOW_WIDTH / 2.0f) {
-		if (bp.y > this->position.y + this->height) {
-			this->velocity_y = this->baseVelocity;
-		}
-		else if (bp.y < this->position.y) {
-			this->velocity_y = -1 * this->baseVelocity;
+void SoftwareCanvas::draw(const Text& text) {
+	string s = text.getString().toAnsiString();
+	if (s.empty()) {
+		return;
+	}
+	CanvasCommand command;
+	command.type = CANVAS_TEXT;
+	command.color = text.getFillColor();
+	command.textStart = (int)this->text.size();
+	command.textLength = (int)s.size();
+	command.textPixel = text.getCharacterSize() / 8.0f;
+	this->text.insert(this->text.end(), s.begin(), s.end());
+
+	// 6 font pixels per character and 10 per line
+	int columns = 0;
+	int lines = 1;
+	int column = 0;
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == '\n') {
+			lines++;
+			column = 0;
 		}
 		else {
-			this->velocity_y = 0.0f;
+			column++;
+			columns = max(columns, column);
 		}
 	}
-	else {
-		this->velocity_y = 0.0f;
+	this->add(command, text, columns * 6.0f * command.textPixel, lines * 10.0f * command.textPixel);
+}
+
+void SoftwareCanvas::display() {
+	// every band runs the whole command list over its rows
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->finished = 0;
+		this->frame++;
 	}
+	this->wake.notify_all();
+	this->rasterize(0);
+	unique_lock<mutex> guard(this->lock);
+	this->done.wait(guard, [this]() { return this->finished == this->threads - 1; });
 }
 
-void Paddle::setVelocityPlayer(float dt, bool down, bool up) {
-	// set velocity on bools
-	if (down && up || !(down || up)) {
-		// no buttons or both buttons gives no net change
-		this->velocity_y = 0.0f;
+void SoftwareCanvas::work(int band) {
+	uint32_t seen = 0;
+	while (true) {
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->wake.wait(guard, [&]() { return this->stopping || this->frame != seen; });
+			if (this->stopping) {
+				return;
+			}
+			seen = this->frame;
+		}
+		this->rasterize(band);
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->finished++;
+		}
+		this->done.notify_one();
 	}
-	else if (down) {
-		this->velocity_y = this->baseVelocity;
+}
+
+void SoftwareCanvas::rasterize(int band) {
+	int top = (int)((uint64_t)this->height * band / this->threads);
+	int bottom = (int)((uint64_t)this->height * (band + 1) / this->threads);
+	int w = (int)this->width;
+
+	uint8_t* rows = this->pixels.data() + (size_t)top * w * 4;
+	for (size_t i = 0; i < (size_t)(bottom - top) * w; i++) {
+		rows[i * 4] = this->clearColor.r;
+		rows[i * 4 + 1] = this->clearColor.g;
+		rows[i * 4 + 2] = this->clearColor.b;
+		rows[i * 4 + 3] = 255;
+	}
+
+	int lineStarts[64];
+	for (size_t n = 0; n < this->commands.size(); n++) {
+		const CanvasCommand& command = this->commands[n];
+		// clamped as floats, a shape far off screen could overflow int
+		int x0 = (int)max(0.0f, floor(command.bounds[0]));
+		int x1 = (int)min((float)w, ceil(command.bounds[2]));
+		int y0 = (int)max((float)top, floor(command.bounds[1]));
+		int y1 = (int)min((float)bottom, ceil(command.bounds[3]));
+		if (x0 >= x1 || y0 >= y1) {
+			continue;
+		}
+
+		const char* chars = command.type == CANVAS_TEXT ? &this->text[command.textStart] : nullptr;
+		int lineCount = 0;
+		if (chars != nullptr) {
+			lineStarts[lineCount++] = 0;
+			for (int i = 0; i < command.textLength && lineCount < 64; i++) {
+				if (chars[i] == '\n') {
+					lineStarts[lineCount++] = i + 1;
+				}
+			}
+		}
+
+		const float* m = command.toLocal;
+		float radius = command.width / 2.0f;
+		bool sprite = command.type == CANVAS_SPRITE;
+		const uint8_t* texels = sprite ? command.image->getPixelsPtr() : nullptr;
+		unsigned imageWidth = sprite ? command.image->getSize().x : 0;
+		unsigned imageHeight = sprite ? command.image->getSize().y : 0;
+		for (int y = y0; y < y1; y++) {
+			uint8_t* out = this->pixels.data() + ((size_t)y * w + x0) * 4;
+			float py = y + 0.5f;
+			for (int x = x0; x < x1; x++, out += 4) {
+				// pixel centers back into the shape's own coordinates
+				float px = x + 0.5f;
+				float lx = m[0] * px + m[1] * py + m[2];
+				float ly = m[3] * px + m[4] * py + m[5];
+				if (lx < 0.0f || ly < 0.0f || lx >= command.width || ly >= command.height) {
+					continue;
+				}
+				Color color = command.color;
+				if (command.type == CANVAS_CIRCLE) {
+					float dx = lx - radius;
+					float dy = ly - radius;
+					if (dx * dx + dy * dy > radius * radius) {
+						continue;
+					}
+				}
+				else if (command.type == CANVAS_SPRITE) {
+					const IntRect& rect = command.textureRect;
+					unsigned sx = (unsigned)(rect.left + (rect.width < 0 ? -1 - (int)lx : (int)lx));
+					unsigned sy = (unsigned)(rect.top + (rect.height < 0 ? -1 - (int)ly : (int)ly));
+					if (sx >= imageWidth || sy >= imageHeight) {
+						continue;
+					}
+					const uint8_t* texel = texels + ((size_t)sy * imageWidth + sx) * 4;
+					if (color != Color::White) {
+						color = Color(texel[0] * color.r / 255, texel[1] * color.g / 255, texel[2] * color.b / 255, texel[3] * color.a / 255);
+					}
+					else {
+						color = Color(texel[0], texel[1], texel[2], texel[3]);
+					}
+				}
+				else if (command.type == CANVAS_TEXT) {
+					int fx = (int)(lx / command.textPixel);
+					int fy = (int)(ly / command.textPixel);
+					int line = fy / 10;
+					int column = fx / 6;
+					if (line >= lineCount || fx % 6 >= 5 || fy % 10 >= 7) {
+						continue;
+					}
+					int index = lineStarts[line] + column;
+					int end = line + 1 < lineCount ? lineStarts[line + 1] - 1 : command.textLength;
+					if (index >= end) {
+						continue;
+					}
+					int glyph = (unsigned char)chars[index] - CANVAS_FONT_FIRST;
+					if (glyph < 0 || glyph >= CANVAS_FONT_COUNT || !(CANVAS_FONT[glyph][fx % 6] & (1 << (fy % 10)))) {
+						continue;
+					}
+				}
+
+				// alpha blend, same as SFML's default blend mode
+				int alpha = color.a;
+				if (alpha == 255) {
+					out[0] = color.r;
+					out[1] = color.g;
+					out[2] = color.b;
+					continue;
+				}
+				out[0] = (uint8_t)((color.r * alpha + out[0] * (255 - alpha) + 127) / 255);
+				out[1] = (uint8_t)((color.g * alpha + out[1] * (255 - alpha) + 127) / 255);
+				out[2] = (uint8_t)((color.b * alpha + out[2] * (255 - alpha) + 127) / 255);
+			}
+		}
 	}
-	else if (up) {
-		this->velocity_y = -1 * this->baseVelocity;
+}
+
+const uint8_t* SoftwareCanvas::getPixels() {
+	return this->pixels.data();
+}
+
+unsigned SoftwareCanvas::getWidth() {
+	return this->width;
+}
+
+unsigned SoftwareCanvas::getHeight() {
+	return this->height;
+}
+
+int SoftwareCanvas::getThreads() {
+	return this->threads;
+}
+
+uint64_t SoftwareCanvas::getChecksum() {
+	// FNV-1a over the framebuffer
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < this->pixels.size(); i++) {
+		hash = (hash ^ this->pixels[i]) * 1099511628211ull;
 	}
+	return hash;
 }
 
-void Paddle::draw(RenderWindow* window) {
-	this->shape.setPosition(this->position);
-	window->draw(this->shape);
+bool SoftwareCanvas::save(string filename) {
+	// binary PPM, readable by most image tools without any encoder here
+	ofstream file(filename, ios::binary);
+	if (!file) {
+		return false;
+	}
+	file << "P6\n" << this->width << " " << this->height << "\n255\n";
+	for (size_t i = 0; i < this->pixels.size(); i += 4) {
+		file.write((const char*)&this->pixels[i], 3);
+	}
+	return (bool)file;
 }
 
 /*
-Ball class for SFML Pong
-Represents the ball, handles movement and bouncing, as well as randomizing velocity
+Powerup class for SFML Pong
+Draws a circle on the screen and carries the effect it triggers when a ball collects it.
 */
-class Ball {
+enum PowerUpEffect { EFFECT_MULTIBALL, EFFECT_SPLIT, EFFECT_GROW, EFFECT_SHRINK, EFFECT_SPEED, EFFECT_COUNT };
+
+class PowerUp {
 public:
-	Ball(Vector2f position);
-	Ball(Vector2f position, Vector2f velocity);
-	void draw(RenderWindow* window);
-	void update(float dt);
-	void bounce(Paddle p);
-	void bounceSimple();
+	PowerUp();
+	PowerUp(Vector2f position);
+	void setup(Vector2f position, PowerUpEffect effect, float amount, float duration);
+	void draw(Canvas* canvas);
 	Vector2f getPosition();
-	void setPosition(Vector2f newPosition);
 	float getRadius();
-	void setRadius(float newrad);
-	void randomizeStartVelocity();
-	Vector2f getVelocity();
-	void setVelocity(Vector2f velocity);
-	int isOffScreen();
-	bool isActive();
-	void setActive(bool state);
+	PowerUpEffect getEffect();
+	float getAmount();
+	float getDuration();
 private:
-	Vector2f velocity;
-	float baseSpeed;
-	Vector2f position;
 	CircleShape shape;
+	Vector2f position;
 	float radius;
-	int colorCycleCount; // for flashing ball
-	int offScreen;
-	bool active;
+	PowerUpEffect effect;
+	float amount;
+	float duration;
 };
 
-Ball::Ball(Vector2f position) {
-	// set up shape
-	this->radius = 5;
-	this->shape = CircleShape(this->radius);
-	this->shape.setFillColor(Color::Blue);
-
-	// set up position and velocity
-	this->position = position;
-	this->baseSpeed = 0.4f;
-	this->randomizeStartVelocity();
-
-	this->colorCycleCount = 10;
-	this->active = false;
+PowerUp::PowerUp() : PowerUp(Vector2f(0.0f, 0.0f)) {
 }
-Ball::Ball(Vector2f position, Vector2f velocity) {
-	// set up shape
-	this->radius = 5;
+
+PowerUp::PowerUp(Vector2f position) {
+	this->radius = 10.0f;
 	this->shape = CircleShape(this->radius);
-	this->shape.setFillColor(Color::Blue);
+	this->setup(position, EFFECT_MULTIBALL, 1.0f, 0.0f);
+}
 
-	// set up position and velocity
+void PowerUp::setup(Vector2f position, PowerUpEffect effect, float amount, float duration) {
 	this->position = position;
-	this->baseSpeed = 0.4f;
-	this->velocity = velocity;
+	this->effect = effect;
+	this->amount = amount;
+	this->duration = duration;
 
-	this->colorCycleCount = 10;
-	this->active = false;
+	// color tells the players what they are going for
+	if (effect == EFFECT_MULTIBALL) {
+		this->shape.setFillColor(Color(200, 0, 255));
+	}
+	else if (effect == EFFECT_SPLIT) {
+		this->shape.setFillColor(Color(255, 0, 140));
+	}
+	else if (effect == EFFECT_GROW) {
+		this->shape.setFillColor(Color(0, 220, 90));
+	}
+	else if (effect == EFFECT_SHRINK) {
+		this->shape.setFillColor(Color(255, 120, 0));
+	}
+	else {
+		this->shape.setFillColor(Color(0, 200, 255));
+	}
 }
 
-bool Ball::isActive() {
-	return this->active;
+Vector2f PowerUp::getPosition() {
+	return this->position;
 }
 
-void Ball::setActive(bool state) {
+float PowerUp::getRadius() {
+	return this->radius;
+}
+
+PowerUpEffect PowerUp::getEffect() {
+	return this->effect;
+}
+
+float PowerUp::getAmount() {
+	return this->amount;
+}
+
+float PowerUp::getDuration() {
+	return this->duration;
+}
+
+void PowerUp::draw(Canvas* canvas) {
+	// correct for top-left shape origin
+	this->shape.setPosition(Vector2f(this->position.x - this->radius, this->position.y - this->radius));
+	canvas->draw(this->shape);
+}
+
+/*
+Scoreboard class for SFML Pong
+Represents the current score of every player on screen
+*/
+class Scoreboard {
+public:
+	Scoreboard(Vector2f position, const Font& font);
+	Scoreboard(int players, const Font& font);
+	void draw(Canvas* canvas);
+	void update(int player, int points);
+	void reset();
+	int getScore(int player);
+	int getPlayers();
+	void setPlayers(int players);
+	void setPosition(int player, Vector2f position);
+private:
+	vector<int> scores;
+	vector<Text> scoreTexts;
+	Text baseText;
+};
+
+Scoreboard::Scoreboard(Vector2f position, const Font& font) : Scoreboard(2, font) {
+	// two players, left score to the left of position and right score to the right
+	this->setPosition(0, Vector2f(position.x - 100.0f, position.y));
+	this->setPosition(1, Vector2f(position.x + 80.0f, position.y));
+}
+
+Scoreboard::Scoreboard(int players, const Font& font) {
+	// font is owned by the asset loader
+	this->baseText = Text("0", font, 30);
+	this->baseText.setFillColor(sf::Color::White);
+	this->baseText.setStyle(sf::Text::Bold);
+	this->setPlayers(players);
+}
+
+void Scoreboard::setPlayers(int players) {
+	this->scores.assign(players, 0);
+	this->scoreTexts.assign(players, this->baseText);
+}
+
+void Scoreboard::setPosition(int player, Vector2f position) {
+	this->scoreTexts[player].setPosition(position);
+}
+
+int Scoreboard::getScore(int player) {
+	return this->scores[player];
+}
+
+int Scoreboard::getPlayers() {
+	return (int)this->scores.size();
+}
+
+void Scoreboard::draw(Canvas* canvas) {
+	// draw strings
+	for (size_t i = 0; i < this->scoreTexts.size(); i++) {
+		canvas->draw(this->scoreTexts[i]);
+	}
+}
+
+void Scoreboard::update(int player, int points) {
+	// update score int, and string to reflect it
+	this->scores[player] += points;
+	this->scoreTexts[player].setString(to_string(this->scores[player]));
+}
+
+void Scoreboard::reset() {
+	// update score ints
+	for (size_t i = 0; i < this->scores.size(); i++) {
+		this->scores[i] = 0;
+		this->scoreTexts[i].setString("0");
+	}
+}
+
+/*
+Replay class for SFML Pong
+A recorded match: the random seed plus each tick's timestep and both paddle moves, enough to play the match back exactly.
+File layout: "PREP" magic, version, seed, tick count, then the timesteps (floats) and the left and right moves (bytes).
+*/
+const uint32_t REPLAY_MAGIC = 0x50455250; // "PREP"
+const uint32_t REPLAY_VERSION = 1;
+
+class Replay {
+public:
+	Replay();
+	void begin(unsigned seed);
+	void addTick(float dt, float left, float right);
+	bool save(string filename);
+	bool load(string filename);
+	unsigned getSeed();
+	int getTickCount();
+	float getDt(int tick);
+	float getMove(int tick, int side);
+private:
+	unsigned seed;
+	vector<float> dts;
+	vector<int8_t> moves[2]; // left, right, scaled to -127..127
+};
+
+Replay::Replay() {
+	this->seed = 0;
+}
+
+void Replay::begin(unsigned seed) {
+	this->seed = seed;
+	this->dts.clear();
+	this->moves[0].clear();
+	this->moves[1].clear();
+}
+
+void Replay::addTick(float dt, float left, float right) {
+	this->dts.push_back(dt);
+	this->moves[0].push_back((int8_t)lround(left * 127.0f));
+	this->moves[1].push_back((int8_t)lround(right * 127.0f));
+}
+
+bool Replay::save(string filename) {
+	ofstream file(filename, ios::binary | ios::trunc);
+	uint32_t count = (uint32_t)this->dts.size();
+	file.write((const char*)&REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+	file.write((const char*)&REPLAY_VERSION, sizeof(REPLAY_VERSION));
+	file.write((const char*)&this->seed, sizeof(this->seed));
+	file.write((const char*)&count, sizeof(count));
+	file.write((const char*)this->dts.data(), count * sizeof(float));
+	file.write((const char*)this->moves[0].data(), count);
+	file.write((const char*)this->moves[1].data(), count);
+	return (bool)file;
+}
+
+bool Replay::load(string filename) {
+	ifstream file(filename, ios::binary);
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint32_t count = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&this->seed, sizeof(this->seed));
+	file.read((char*)&count, sizeof(count));
+	if (!file || magic != REPLAY_MAGIC || version != REPLAY_VERSION) {
+		return false;
+	}
+	this->dts.resize(count);
+	this->moves[0].resize(count);
+	this->moves[1].resize(count);
+	file.read((char*)this->dts.data(), count * sizeof(float));
+	file.read((char*)this->moves[0].data(), count);
+	file.read((char*)this->moves[1].data(), count);
+	return (bool)file;
+}
+
+unsigned Replay::getSeed() {
+	return this->seed;
+}
+
+int Replay::getTickCount() {
+	return (int)this->dts.size();
+}
+
+float Replay::getDt(int tick) {
+	if (tick < 0 || tick >= (int)this->dts.size()) {
+		return 0.0f;
+	}
+	return this->dts[tick];
+}
+
+float Replay::getMove(int tick, int side) {
+	// side -1 is the left paddle, 1 the right
+	vector<int8_t>& m = this->moves[side < 0 ? 0 : 1];
+	if (tick < 0 || tick >= (int)m.size()) {
+		return 0.0f;
+	}
+	return m[tick] / 127.0f;
+}
+
+/*
+Paddle controller classes for SFML Pong
+A controller decides which way a paddle moves each tick, from -1 (up) to 1 (down).
+Controllers only see a ControllerView of the paddle and the ball along the paddle's track, so any controller can drive any paddle.
+Interactive play calls decide() through the PaddleController interface. Every controller is final and derives from
+ControllerBase, so templated code (the headless batch runner) can call decide() on the concrete type and have it inline.
+*/
+struct ControllerView {
+	float position; // top of the paddle along its track
+	float length; // paddle length along its track
+	float target; // tracked ball along the paddle's track
+	float distance; // how far the ball is from the paddle, across the track
+	float range; // distance at which the AI starts tracking
+	uint32_t tick; // ticks since the match started
+};
+
+class PaddleController {
+public:
+	virtual ~PaddleController() {}
+	virtual float decide(const ControllerView& view) = 0;
+	virtual void handleEvent(Event&) {}
+	virtual void reset() {}
+};
+
+template <class Derived>
+class ControllerBase : public PaddleController {
+public:
+	float decide(const ControllerView& view) final {
+		return static_cast<Derived*>(this)->decideImpl(view);
+	}
+};
+
+// player paddle driven by two keys
+class KeyboardController final : public ControllerBase<KeyboardController> {
+public:
+	KeyboardController(Keyboard::Key upKey, Keyboard::Key downKey);
+	float decideImpl(const ControllerView& view);
+	void handleEvent(Event& event);
+	void reset();
+private:
+	Keyboard::Key upKey;
+	Keyboard::Key downKey;
+	bool up;
+	bool down;
+};
+
+KeyboardController::KeyboardController(Keyboard::Key upKey, Keyboard::Key downKey) {
+	this->upKey = upKey;
+	this->downKey = downKey;
+	this->reset();
+}
+
+inline float KeyboardController::decideImpl(const ControllerView&) {
+	if ((this->down && this->up) || !(this->down || this->up)) {
+		// no buttons or both buttons gives no net change
+		return 0.0f;
+	}
+	return this->down ? 1.0f : -1.0f;
+}
+
+void KeyboardController::handleEvent(Event& event) {
+	if (event.type == Event::KeyPressed || event.type == Event::KeyReleased) {
+		bool pressed = event.type == Event::KeyPressed;
+		if (event.key.code == this->upKey) {
+			this->up = pressed;
+		}
+		else if (event.key.code == this->downKey) {
+			this->down = pressed;
+		}
+	}
+}
+
+void KeyboardController::reset() {
+	// keys may have been released while we were not listening
+	this->up = false;
+	this->down = false;
+}
+
+// player paddle driven by a joystick's y axis
+class JoystickController final : public ControllerBase<JoystickController> {
+public:
+	JoystickController(unsigned id);
+	float decideImpl(const ControllerView& view);
+private:
+	unsigned id;
+};
+
+JoystickController::JoystickController(unsigned id) {
+	this->id = id;
+}
+
+inline float JoystickController::decideImpl(const ControllerView&) {
+	float axis = Joystick::getAxisPosition(this->id, Joystick::Y) / 100.0f;
+	if (abs(axis) < 0.2f) { // dead zone
+		return 0.0f;
+	}
+	return axis;
+}
+
+// the built-in AI, tracks the ball once it is in range
+class AiController final : public ControllerBase<AiController> {
+public:
+	float decideImpl(const ControllerView& view);
+};
+
+inline float AiController::decideImpl(const ControllerView& view) {
+	if (view.distance < view.range) {
+		if (view.target > view.position + view.length) {
+			return 1.0f;
+		}
+		else if (view.target < view.position) {
+			return -1.0f;
+		}
+	}
+	return 0.0f;
+}
+
+// plays back one side of a recorded match
+class ReplayController final : public ControllerBase<ReplayController> {
+public:
+	ReplayController(Replay* replay, int side);
+	float decideImpl(const ControllerView& view);
+private:
+	Replay* replay;
+	int side;
+};
+
+ReplayController::ReplayController(Replay* replay, int side) {
+	this->replay = replay;
+	this->side = side;
+}
+
+inline float ReplayController::decideImpl(const ControllerView& view) {
+	return this->replay->getMove((int)view.tick - 1, this->side);
+}
+
+// remote player, each UDP datagram carries one signed byte: the move scaled to -127..127
+class NetworkController final : public ControllerBase<NetworkController> {
+public:
+	NetworkController();
+	bool listen(unsigned short port);
+	float decideImpl(const ControllerView& view);
+	void reset();
+private:
+	UdpSocket socket;
+	float move;
+};
+
+NetworkController::NetworkController() {
+	this->move = 0.0f;
+	this->socket.setBlocking(false);
+}
+
+bool NetworkController::listen(unsigned short port) {
+	return this->socket.bind(port) == Socket::Done;
+}
+
+float NetworkController::decideImpl(const ControllerView&) {
+	// keep the newest move, the peer only sends when it changes
+	char data[16];
+	size_t received = 0;
+	IpAddress sender;
+	unsigned short senderPort;
+	while (this->socket.receive(data, sizeof(data), received, sender, senderPort) == Socket::Done) {
+		if (received > 0) {
+			this->move = (int8_t)data[received - 1] / 127.0f;
+		}
+	}
+	return this->move;
+}
+
+void NetworkController::reset() {
+	this->move = 0.0f;
+}
+
+// external agent (scripted bot or trained policy), either a callback or an action set from another thread
+class AgentController final : public ControllerBase<AgentController> {
+public:
+	AgentController();
+	void setPolicy(float (*policy)(const ControllerView& view, void* user), void* user);
+	void setAction(float action);
+	float decideImpl(const ControllerView& view);
+	void reset();
+private:
+	float (*policy)(const ControllerView& view, void* user);
+	void* user;
+	atomic<float> action;
+};
+
+AgentController::AgentController() {
+	this->policy = nullptr;
+	this->user = nullptr;
+	this->action = 0.0f;
+}
+
+void AgentController::setPolicy(float (*policy)(const ControllerView& view, void* user), void* user) {
+	this->policy = policy;
+	this->user = user;
+}
+
+void AgentController::setAction(float action) {
+	this->action = max(-1.0f, min(1.0f, action));
+}
+
+inline float AgentController::decideImpl(const ControllerView& view) {
+	if (this->policy != nullptr) {
+		float action = this->policy(view, this->user);
+		return max(-1.0f, min(1.0f, action));
+	}
+	return this->action;
+}
+
+void AgentController::reset() {
+	this->action = 0.0f;
+}
+
+/*
+Paddle class for SFML Pong
+Represents the paddles on screen, moved by a PaddleController (keyboard, AI, replay...)
+*/
+const float PADDLE_MIN_SCALE = 0.2f; // grow and shrink never go below this or past the window height
+
+class Paddle {
+public:
+	Paddle(Vector2f position);
+	Vector2f getPosition();
+	Vector2f getSize();
+	void draw(Canvas* canvas);
+	void setPosition(Vector2f np);
+	float getHeightScale();
+	void setHeightScale(float scale);
+	float getSpeed();
+	ControllerView getView(Vector2f bp, uint32_t tick);
+	template <class Controller> float update(float dt, Controller& controller, Vector2f bp, uint32_t tick);
+private:
+	void move(float dt, float direction);
+	float velocity_y;
+	Vector2f position;
+	RectangleShape shape;
+	float height;
+	float baseHeight;
+	float heightScale; // from grow and shrink powerups
+	float baseVelocity;
+};
+
+Paddle::Paddle(Vector2f position) {
+	// set up shape
+	this->baseHeight = 70.0f;
+	this->heightScale = 1.0f;
+	this->height = this->baseHeight;
+	this->shape = RectangleShape(Vector2f(10.0f, this->height));
+	this->position = position;
+	this->velocity_y = 0.0f;
+	this->baseVelocity = 0.4f;
+}
+
+void Paddle::setPosition(Vector2f np) {
+	this->position = np;
+}
+
+Vector2f Paddle::getPosition() {
+	return this->position;
+}
+
+Vector2f Paddle::getSize() {
+	return this->shape.getSize();
+}
+
+float Paddle::getHeightScale() {
+	return this->heightScale;
+}
+
+float Paddle::getSpeed() {
+	return this->baseVelocity;
+}
+
+void Paddle::setHeightScale(float scale) {
+	// resize around the paddle's center, move() keeps it on screen
+	// stacked effects keep their full product so undoing them comes back to 1, only the drawn size is clamped
+	float newHeight = this->baseHeight * max(PADDLE_MIN_SCALE, min(scale, WINDOW_HEIGHT / this->baseHeight));
+	this->position.y -= (newHeight - this->height) / 2.0f;
+	this->height = newHeight;
+	this->heightScale = scale;
+	this->shape.setSize(Vector2f(this->shape.getSize().x, this->height));
+}
+
+ControllerView Paddle::getView(Vector2f bp, uint32_t tick) {
+	// paddles track vertically, so the ball's y is along the track and its x distance is across it
+	ControllerView view;
+	view.position = this->position.y;
+	view.length = this->height;
+	view.target = bp.y;
+	view.distance = abs(this->position.x - bp.x);
+	view.range = WINDOW_WIDTH / 2.0f;
+	view.tick = tick;
+	return view;
+}
+
+// asks the controller for a move and applies it, returns the move
+// Controller is PaddleController for virtual dispatch, or a concrete controller to inline the call
+template <class Controller>
+float Paddle::update(float dt, Controller& controller, Vector2f bp, uint32_t tick) {
+	float direction = controller.decide(this->getView(bp, tick));
+	// keep to the 255 steps a replay can store, so recorded matches play back exactly
+	direction = lround(max(-1.0f, min(1.0f, direction)) * 127.0f) / 127.0f;
+	this->move(dt, direction);
+	return direction;
+}
+
+void Paddle::move(float dt, float direction) {
+	this->velocity_y = direction * this->baseVelocity;
+
+	// update position based on velocity
+	this->position.y += this->velocity_y * dt;
+
+	// check y bounds (keep paddle on screen)
+	if (this->position.y + this->height > WINDOW_HEIGHT) {
+		this->position.y = WINDOW_HEIGHT - this->height;
+	}
+	else if (this->position.y < 0) {
+		this->position.y = 0;
+	}
+}
+
+void Paddle::draw(Canvas* canvas) {
+	this->shape.setPosition(this->position);
+	canvas->draw(this->shape);
+}
+
+/*
+Paddle bounce rule for SFML Pong
+ratio is how far from the paddle's middle the ball hit (0 middle, 1 end), normal is the paddle's face and tangent runs along it.
+The ball leaves along the normal turned by up to 75 degrees towards the side it was already heading, 10% faster.
+*/
+Vector2f bounceVelocity(Vector2f velocity, float ratio, Vector2f normal, Vector2f tangent) {
+	// calculate current magnitude and accelerate
+	float currentMagnitude = sqrt(velocity.x * velocity.x + velocity.y * velocity.y); // distance formula for magnitude of velocity
+	currentMagnitude *= 1.1f; // 10% increase in speed each bounce
+
+	float theta = ratio * 75.0f; // angle of exit based on ratio (min 0, max 75)
+	if (theta > 75.0f) {
+		theta = 75.0f;
+	}
+	theta = theta * (PI / 180.0f); // convert to radians
+	if (velocity.x * tangent.x + velocity.y * tangent.y < 0) { // keep heading the same way along the paddle
+		theta *= -1.0f;
+	}
+
+	// determine new components along the normal and tangent with accelerated magnitude
+	float out = cos(theta) * currentMagnitude;
+	float along = sin(theta) * currentMagnitude;
+	return Vector2f(normal.x * out + tangent.x * along, normal.y * out + tangent.y * along);
+}
+
+/*
+Ball class for SFML Pong
+Represents the ball, handles movement and bouncing, as well as randomizing velocity
+*/
+class Ball {
+public:
+	Ball(Vector2f position);
+	Ball(Vector2f position, Vector2f velocity);
+	void draw(Canvas* canvas);
+	bool update(float dt);
+	void bounce(Paddle p);
+	void bounceSimple();
+	Vector2f getPosition();
+	void setPosition(Vector2f newPosition);
+	float getRadius();
+	void setRadius(float newrad);
+	void randomizeStartVelocity();
+	Vector2f getVelocity();
+	void setVelocity(Vector2f velocity);
+	int isOffScreen();
+	bool isActive();
+	void setActive(bool state);
+	int getLastHit();
+	void setLastHit(int side);
+private:
+	Vector2f velocity;
+	float baseSpeed;
+	Vector2f position;
+	CircleShape shape;
+	float radius;
+	int colorCycleCount; // for flashing ball
+	int offScreen;
+	bool active;
+	int lastHit; // side of the last paddle to hit the ball, 0 if none yet
+};
+
+Ball::Ball(Vector2f position) {
+	// set up shape
+	this->radius = 5;
+	this->shape = CircleShape(this->radius);
+	this->shape.setFillColor(Color::Blue);
+
+	// set up position and velocity
+	this->position = position;
+	this->baseSpeed = 0.4f;
+	this->randomizeStartVelocity();
+
+	this->colorCycleCount = 10;
+	this->active = false;
+	this->lastHit = 0;
+}
+Ball::Ball(Vector2f position, Vector2f velocity) {
+	// set up shape
+	this->radius = 5;
+	this->shape = CircleShape(this->radius);
+	this->shape.setFillColor(Color::Blue);
+
+	// set up position and velocity
+	this->position = position;
+	this->baseSpeed = 0.4f;
+	this->velocity = velocity;
+
+	this->colorCycleCount = 10;
+	this->active = false;
+	this->lastHit = 0;
+}
+
+bool Ball::isActive() {
+	return this->active;
+}
+
+void Ball::setActive(bool state) {
 	this->active = state;
 }
 
-int Ball::isOffScreen() {
-	return this->offScreen;
+int Ball::getLastHit() {
+	return this->lastHit;
+}
+
+void Ball::setLastHit(int side) {
+	this->lastHit = side;
+}
+
+int Ball::isOffScreen() {
+	return this->offScreen;
+}
+
+void Ball::setVelocity(Vector2f velocity) {
+	this->velocity = velocity;
+}
+
+Vector2f Ball::getVelocity() {
+	return this->velocity;
+}
+
+void Ball::randomizeStartVelocity() {
+	float theta = rand() % 11 + 1; // rand 1-10
+	theta = (theta / 10) * (PI / 4.0f); // rand 0-Pi/4
+	float newX = cos(theta) * this->baseSpeed;
+	float newY = sin(theta) * this->baseSpeed;
+
+	int flipY = rand() % 2; // 50% chance to flip y
+	if (flipY == 0) {
+		newY *= -1;
+	}
+	int flipX = rand() % 2; // 50% chance to flip x (shoot at other player)
+	if (flipX == 0) {
+		newX *= -1;
+	}
+
+	this->velocity = Vector2f(newX, newY);
+}
+
+void Ball::setPosition(Vector2f newPosition) {
+	this->position = newPosition;
+}
+
+void Ball::setRadius(float newrad) {
+	if (newrad >= 1) { // check to make sure ball would be visible
+		this->radius = newrad;
+	}
+	this->shape.setRadius(this->radius);
+}
+
+void Ball::bounce(Paddle p) {
+	// calculate new angle
+	float midP = p.getPosition().y + p.getSize().y / 2.0f; // midpoint of the paddle (y)
+	float spread = abs(midP - this->position.y); // distance from midpoint y to ball center y
+	float ratio = spread / (p.getSize().y / 2.0f); // ratio of distance to total paddle height (between 0-1)
+
+	// paddle faces back the way the ball came, and runs along y
+	Vector2f normal = Vector2f(this->velocity.x > 0 ? -1.0f : 1.0f, 0.0f);
+	this->velocity = bounceVelocity(this->velocity, ratio, normal, Vector2f(0.0f, 1.0f));
+}
+
+void Ball::bounceSimple() { // no angle change calcs
+	this->velocity = Vector2f(-1.0f * this->velocity.x, this->velocity.y);
+}
+
+// returns true when the ball bounced off the top or bottom
+bool Ball::update(float dt) {
+	this->position.x += this->velocity.x * dt;
+	this->position.y += this->velocity.y * dt;
+
+	// kooky colors
+	if (this->colorCycleCount > 3) {
+		this->colorCycleCount = 0;
+		this->shape.setFillColor(Color(rand(), rand(), rand()));
+	}
+	else {
+		this->colorCycleCount++;
+	}
+
+	// check x bounds
+	if (this->position.x + this->radius > WINDOW_WIDTH) {
+		this->offScreen = 1;
+	}
+	else if (this->position.x - this->radius < 0) {
+		this->offScreen = -1;
+	}
+	else {
+		this->offScreen = 0;
+	}
+
+	// check y bounds
+	if (this->position.y + this->radius > WINDOW_HEIGHT) { // if below window
+		this->position.y = WINDOW_HEIGHT - this->radius; // set to window bottom and flip
+		this->velocity.y *= -1;
+	}
+	else if (this->position.y - this->radius < 0) { // if above window
+		this->position.y = this->radius; // set to window top and flip
+		this->velocity.y *= -1;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void Ball::draw(Canvas* canvas) {
+	// correct for SHAPE POSITION top-left origin
+	this->shape.setPosition(Vector2f(this->position.x - this->radius, this->position.y - this->radius));
+	canvas->draw(this->shape);
+}
+
+Vector2f Ball::getPosition() {
+	return Vector2f(this->position.x, this->position.y);
+}
+
+float Ball::getRadius() {
+	return this->radius;
+}
+
+
+/*
+Checks for collision between two circles
+b1p and b2p are the CENTER positions of the two circles
+*/
+bool collisionCircle(Vector2f b1p, float b1r, Vector2f b2p, float b2r) {
+
+	//compute distance between centers
+	float dist = sqrt( (b1p.x - b2p.x) * (b1p.x - b2p.x) + (b1p.y - b2p.y) * (b1p.y - b2p.y) );
+	float radiiSum = b1r + b2r;
+	if (dist <= radiiSum) {
+		return true;
+	}
+	return false;
+}
+
+/*
+Checks for circle-rectangle collisions for the ball and paddle
+bp is the CENTER position of the circle, pp is the TOP LEFT of the paddle
+*/
+bool collisionRectangle(Ball *ball, Paddle *paddle) {
+	Vector2f bp = ball->getPosition();
+	float br = ball->getRadius();
+	Vector2f pp = paddle->getPosition();
+	Vector2f ps = paddle->getSize();
+
+
+	float testX = bp.x;
+	float testY = bp.y;
+	if (bp.x < pp.x) {
+		// ball center left from left edge
+		testX = pp.x;
+	}
+	else if (bp.x > pp.x + ps.x) {
+		// ball center right of right edge
+		testX = pp.x + ps.x;
+	}
+	// else ball center within x range
+
+	if (bp.y < pp.y) {
+		// ball center up from top edge
+		testY = pp.y;
+	}
+	else if (bp.y > pp.y + ps.y) {
+		// ball center down from bottom edge
+		testY = pp.y + ps.y;
+	}
+	// else ball center within y range
+
+	// calculate pythagorean distance from ball to closest edge
+	float distX = bp.x - testX;
+	float distY = bp.y - testY;
+	float pythagDist = sqrt((distX * distX) + (distY * distY));
+	
+	if (pythagDist <= br) { // pythag collision
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+/*
+Telemetry classes for SFML Pong
+Game events (bounces, scores, powerups, match ends) are written as fixed-size records into a ring buffer owned by
+the calling thread, so recording never takes a lock. A background thread drains the rings every few milliseconds
+and writes them to disk in blocks, one compressed column per record field.
+
+File layout: "PTEL" magic and a version, then blocks of [record count][column byte length, column bytes] x columns.
+Integer columns store the zigzag varint of the difference from the previous value. Float columns store the XOR with
+the previous value's bits, with a header byte counting its leading and trailing zero bytes and only the middle bytes.
+*/
+enum TelemetryEvent { TELEMETRY_BOUNCE, TELEMETRY_SCORE, TELEMETRY_POWERUP, TELEMETRY_MATCH_END };
+
+// 32 bytes, meaning of the fields depends on the event (see Game::update)
+struct TelemetryRecord {
+	uint32_t match;
+	uint32_t tick;
+	uint16_t type;
+	int16_t side; // -1 left, 1 right, or the effect for powerup records
+	uint16_t rally; // paddle hits since the last serve
+	uint16_t balls; // active balls at the time
+	float x;
+	float y;
+	float speed;
+	float offset; // hit position on the paddle, -1 top edge to 1 bottom edge
+};
+
+const int TELEMETRY_RING_SIZE = 4096; // must be a power of two
+const int TELEMETRY_BLOCK_SIZE = 8192;
+const int TELEMETRY_INT_COLUMNS = 6;
+const int TELEMETRY_FLOAT_COLUMNS = 4;
+const uint32_t TELEMETRY_MAGIC = 0x4C455450; // "PTEL"
+const uint32_t TELEMETRY_VERSION = 1;
+
+class TelemetryRing {
+public:
+	TelemetryRing();
+	bool push(const TelemetryRecord& record);
+	void drain(vector<TelemetryRecord>* out);
+private:
+	TelemetryRecord records[TELEMETRY_RING_SIZE];
+	atomic<uint32_t> head; // only moved by the producing thread
+	atomic<uint32_t> tail; // only moved by the flush thread
+};
+
+TelemetryRing::TelemetryRing() {
+	this->head = 0;
+	this->tail = 0;
+}
+
+bool TelemetryRing::push(const TelemetryRecord& record) {
+	uint32_t head = this->head.load(memory_order_relaxed);
+	if (head - this->tail.load(memory_order_acquire) >= (uint32_t)TELEMETRY_RING_SIZE) {
+		return false; // full, drop rather than stall the game
+	}
+	this->records[head & (TELEMETRY_RING_SIZE - 1)] = record;
+	this->head.store(head + 1, memory_order_release);
+	return true;
+}
+
+void TelemetryRing::drain(vector<TelemetryRecord>* out) {
+	uint32_t tail = this->tail.load(memory_order_relaxed);
+	uint32_t head = this->head.load(memory_order_acquire);
+	while (tail != head) {
+		out->push_back(this->records[tail & (TELEMETRY_RING_SIZE - 1)]);
+		tail++;
+	}
+	this->tail.store(tail, memory_order_release);
+}
+
+class TelemetryLogger {
+public:
+	TelemetryLogger();
+	~TelemetryLogger();
+	bool open(string filename);
+	void close();
+	void record(const TelemetryRecord& record);
+	uint64_t getWritten();
+	uint64_t getDropped();
+private:
+	TelemetryRing* getRing();
+	void flushLoop();
+	void writeBlock();
+	ofstream file;
+	mutex ringsMutex; // only taken when a thread logs for the first time
+	vector<unique_ptr<TelemetryRing>> rings;
+	vector<TelemetryRecord> pending;
+	vector<uint8_t> encoded;
+	thread flusher;
+	mutex wakeMutex;
+	condition_variable wake;
+	atomic<bool> running;
+	atomic<uint64_t> dropped;
+	uint64_t written;
+};
+
+// zigzag varint and xor float encoders for the columns
+void telemetryPutVarint(vector<uint8_t>* out, uint64_t value) {
+	while (value >= 0x80) {
+		out->push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out->push_back((uint8_t)value);
+}
+
+void telemetryPutInt(vector<uint8_t>* out, int64_t value, int64_t* previous) {
+	int64_t delta = value - *previous;
+	*previous = value;
+	telemetryPutVarint(out, (uint64_t)((delta << 1) ^ (delta >> 63)));
+}
+
+void telemetryPutFloat(vector<uint8_t>* out, float value, uint32_t* previous) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t diff = bits ^ *previous;
+	*previous = bits;
+
+	int lead = 0;
+	while (lead < 4 && ((diff >> (24 - 8 * lead)) & 0xFF) == 0) {
+		lead++;
+	}
+	int trail = 0;
+	while (trail < 4 - lead && ((diff >> (8 * trail)) & 0xFF) == 0) {
+		trail++;
+	}
+	out->push_back((uint8_t)((lead << 4) | trail));
+	for (int i = 3 - lead; i >= trail; i--) {
+		out->push_back((uint8_t)(diff >> (8 * i)));
+	}
+}
+
+TelemetryLogger::TelemetryLogger() {
+	this->running = false;
+	this->dropped = 0;
+	this->written = 0;
+}
+
+TelemetryLogger::~TelemetryLogger() {
+	this->close();
+}
+
+bool TelemetryLogger::open(string filename) {
+	this->file.open(filename, ios::binary | ios::trunc);
+	if (!this->file) {
+		return false;
+	}
+	this->file.write((const char*)&TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+	this->file.write((const char*)&TELEMETRY_VERSION, sizeof(TELEMETRY_VERSION));
+	this->pending.reserve(TELEMETRY_BLOCK_SIZE + TELEMETRY_RING_SIZE);
+	this->running = true;
+	this->flusher = thread(&TelemetryLogger::flushLoop, this);
+	return true;
+}
+
+void TelemetryLogger::close() {
+	if (!this->running) {
+		return;
+	}
+	{
+		lock_guard<mutex> lock(this->wakeMutex);
+		this->running = false;
+	}
+	this->wake.notify_one();
+	this->flusher.join(); // the flush thread writes everything left before it exits
+	this->file.close();
+}
+
+TelemetryRing* TelemetryLogger::getRing() {
+	// each thread gets its own ring the first time it records
+	thread_local TelemetryLogger* owner = nullptr;
+	thread_local TelemetryRing* ring = nullptr;
+	if (owner != this) {
+		lock_guard<mutex> lock(this->ringsMutex);
+		this->rings.push_back(unique_ptr<TelemetryRing>(new TelemetryRing()));
+		ring = this->rings.back().get();
+		owner = this;
+	}
+	return ring;
+}
+
+void TelemetryLogger::record(const TelemetryRecord& record) {
+	if (!this->running) {
+		return;
+	}
+	if (!this->getRing()->push(record)) {
+		this->dropped.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+uint64_t TelemetryLogger::getWritten() {
+	return this->written; // only meaningful after close()
+}
+
+uint64_t TelemetryLogger::getDropped() {
+	return this->dropped;
+}
+
+void TelemetryLogger::flushLoop() {
+	bool stopping = false;
+	while (!stopping) {
+		{
+			unique_lock<mutex> lock(this->wakeMutex);
+			this->wake.wait_for(lock, chrono::milliseconds(20));
+			stopping = !this->running;
+		}
+
+		{
+			lock_guard<mutex> lock(this->ringsMutex);
+			for (size_t i = 0; i < this->rings.size(); i++) {
+				this->rings[i]->drain(&this->pending);
+			}
+		}
+
+		if ((int)this->pending.size() >= TELEMETRY_BLOCK_SIZE || (stopping && !this->pending.empty())) {
+			this->writeBlock();
+		}
+	}
+}
+
+void TelemetryLogger::writeBlock() {
+	// transpose the pending records into columns and encode each one
+	uint32_t count = (uint32_t)this->pending.size();
+	this->file.write((const char*)&count, sizeof(count));
+
+	for (int column = 0; column < TELEMETRY_INT_COLUMNS + TELEMETRY_FLOAT_COLUMNS; column++) {
+		this->encoded.clear();
+		int64_t previousInt = 0;
+		uint32_t previousFloat = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			const TelemetryRecord& r = this->pending[i];
+			switch (column) {
+			case 0: telemetryPutInt(&this->encoded, r.match, &previousInt); break;
+			case 1: telemetryPutInt(&this->encoded, r.tick, &previousInt); break;
+			case 2: telemetryPutInt(&this->encoded, r.type, &previousInt); break;
+			case 3: telemetryPutInt(&this->encoded, r.side, &previousInt); break;
+			case 4: telemetryPutInt(&this->encoded, r.rally, &previousInt); break;
+			case 5: telemetryPutInt(&this->encoded, r.balls, &previousInt); break;
+			case 6: telemetryPutFloat(&this->encoded, r.x, &previousFloat); break;
+			case 7: telemetryPutFloat(&this->encoded, r.y, &previousFloat); break;
+			case 8: telemetryPutFloat(&this->encoded, r.speed, &previousFloat); break;
+			case 9: telemetryPutFloat(&this->encoded, r.offset, &previousFloat); break;
+			}
+		}
+		uint32_t length = (uint32_t)this->encoded.size();
+		this->file.write((const char*)&length, sizeof(length));
+		this->file.write((const char*)this->encoded.data(), length);
+	}
+	this->file.flush();
+
+	this->written += count;
+	this->pending.clear();
+}
+
+/*
+Telemetry reader for SFML Pong
+Decodes telemetry files back into records, see TelemetryLogger for the format.
+*/
+uint64_t telemetryGetVarint(const uint8_t** p, const uint8_t* end, bool* corrupt) {
+	uint64_t value = 0;
+	int shift = 0;
+	while (*p < end) {
+		if (shift > 63) {
+			*corrupt = true; // no uint64_t takes more than 10 bytes
+			break;
+		}
+		uint8_t byte = *(*p)++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			break;
+		}
+		shift += 7;
+	}
+	return value;
+}
+
+int64_t telemetryGetInt(const uint8_t** p, const uint8_t* end, int64_t* previous, bool* corrupt) {
+	uint64_t zigzag = telemetryGetVarint(p, end, corrupt);
+	uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+	*previous = (int64_t)((uint64_t)*previous + delta); // wraps instead of overflowing on corrupt deltas
+	return *previous;
+}
+
+float telemetryGetFloat(const uint8_t** p, const uint8_t* end, uint32_t* previous) {
+	uint32_t diff = 0;
+	if (*p < end) {
+		uint8_t header = *(*p)++;
+		int lead = header >> 4;
+		int trail = header & 0x0F;
+		for (int i = 3 - lead; i >= trail && *p < end; i--) {
+			diff |= (uint32_t)(*(*p)++) << (8 * i);
+		}
+	}
+	*previous ^= diff;
+	float value;
+	memcpy(&value, previous, sizeof(value));
+	return value;
+}
+
+// fails only on a bad header, a file cut off mid-block keeps the blocks before the cut
+bool readTelemetryFile(string filename, vector<TelemetryRecord>* out) {
+	ifstream file(filename, ios::binary | ios::ate);
+	uint64_t fileSize = file ? (uint64_t)file.tellg() : 0;
+	file.seekg(0);
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	if (!file || magic != TELEMETRY_MAGIC || version != TELEMETRY_VERSION) {
+		return false;
+	}
+
+	const int columns = TELEMETRY_INT_COLUMNS + TELEMETRY_FLOAT_COLUMNS;
+	uint32_t count;
+	vector<uint8_t> bytes;
+	while (file.read((char*)&count, sizeof(count))) {
+		// every value takes at least a byte, so a count the rest of the file can't hold is corrupt
+		uint64_t left = fileSize - (uint64_t)file.tellg();
+		if ((uint64_t)count * columns + columns * sizeof(uint32_t) > left) {
+			cerr << filename << ": block of " << count << " records runs past the end of the file, skipping the rest" << endl;
+			break;
+		}
+		size_t first = out->size();
+		out->resize(first + count);
+		bool truncated = false;
+		bool corrupt = false;
+		for (int column = 0; column < columns; column++) {
+			uint32_t length = 0;
+			file.read((char*)&length, sizeof(length));
+			if (!file || length > fileSize - (uint64_t)file.tellg()) {
+				truncated = true;
+				break;
+			}
+			bytes.resize(length);
+			file.read((char*)bytes.data(), length);
+			if (!file) {
+				truncated = true;
+				break;
+			}
+
+			const uint8_t* p = bytes.data();
+			const uint8_t* end = p + length;
+			int64_t previousInt = 0;
+			uint32_t previousFloat = 0;
+			for (uint32_t i = 0; i < count && !corrupt; i++) {
+				TelemetryRecord& r = (*out)[first + i];
+				switch (column) {
+				case 0: r.match = (uint32_t)telemetryGetInt(&p, end, &previousInt, &corrupt); break;
+				case 1: r.tick = (uint32_t)telemetryGetInt(&p, end, &previousInt, &corrupt); break;
+				case 2: r.type = (uint16_t)telemetryGetInt(&p, end, &previousInt, &corrupt); break;
+				case 3: r.side = (int16_t)telemetryGetInt(&p, end, &previousInt, &corrupt); break;
+				case 4: r.rally = (uint16_t)telemetryGetInt(&p, end, &previousInt, &corrupt); break;
+				case 5: r.balls = (uint16_t)telemetryGetInt(&p, end, &previousInt, &corrupt); break;
+				case 6: r.x = telemetryGetFloat(&p, end, &previousFloat); break;
+				case 7: r.y = telemetryGetFloat(&p, end, &previousFloat); break;
+				case 8: r.speed = telemetryGetFloat(&p, end, &previousFloat); break;
+				case 9: r.offset = telemetryGetFloat(&p, end, &previousFloat); break;
+				}
+			}
+		}
+		if (truncated) {
+			// a game killed mid-write leaves a partial last block
+			out->resize(first);
+			cerr << filename << ": last block is cut off, keeping the complete blocks before it" << endl;
+			break;
+		}
+		if (corrupt) {
+			// the column lengths still line up, so only this block is lost
+			out->resize(first);
+			cerr << filename << ": block of " << count << " records holds a corrupt value, skipping it" << endl;
+		}
+	}
+	return true;
+}
+
+/*
+Sound synth for SFML Pong
+Sound effects are synthesized instead of loaded: each game event starts a voice whose pitch and loudness follow the
+ball speed and where it hit. Synth streams the voices to the sound card in small blocks from SFML's audio thread,
+frame capture renders the same voices into its WAV track.
+Voices render 8 samples at a time with the per-sample state held in fixed size lanes, so the inner loops have no
+dependencies between samples and compile to vector code. Nothing allocates once the synth is built.
+*/
+const unsigned SYNTH_SAMPLE_RATE = 44100;
+const unsigned SYNTH_CHANNELS = 2;
+const int SYNTH_BLOCK_FRAMES = 512; // 11.6 ms per block, SFML keeps 3 blocks queued
+const int SYNTH_HEADROOM_BLOCKS = 2; // still queued on the card when SFML asks for the next block
+const int SYNTH_MAX_VOICES = 32;
+const int SYNTH_LANES = 8;
+const int SYNTH_QUEUE_SIZE = 64; // events between audio blocks, power of two
+const int SYNTH_NOISE_SIZE = 4096; // white noise table, power of two
+
+enum SynthSound {
+	SYNTH_IMPACT, // ball off a paddle
+	SYNTH_WALL, // ball off the top or bottom
+	SYNTH_POWERUP
+};
+
+struct SynthEvent {
+	uint8_t sound;
+	float speed; // ball speed in px/ms
+	float offset; // paddle hits, -1 top edge to 1 bottom edge
+	float pan; // -1 left to 1 right
+};
+
+SynthEvent synthEvent(SynthSound sound, float speed, float offset, float x) {
+	SynthEvent event;
+	event.sound = (uint8_t)sound;
+	event.speed = speed;
+	event.offset = max(-1.0f, min(1.0f, offset));
+	event.pan = max(-1.0f, min(1.0f, x / WINDOW_WIDTH * 2.0f - 1.0f)) * 0.7f; // never hard left or right
+	return event;
+}
+
+struct SynthVoice {
+	float phase; // -1 to 1 over one period
+	float step; // phase per sample
+	float sweep; // step multiplier per lane block, pitch glide
+	float amp; // envelope at the start of the next lane block
+	float decay; // envelope multiplier per lane block
+	alignas(32) float decayLanes[SYNTH_LANES]; // envelope within a lane block
+	float gainLeft;
+	float gainRight;
+	float noise; // 0 pure tone, 1 pure noise
+	uint32_t noisePosition; // in the noise table
+};
+
+class SynthVoices {
+public:
+	SynthVoices(unsigned sampleRate);
+	void trigger(const SynthEvent& event);
+	void render(float* left, float* right, int frames);
+	void reset();
+	int getActiveCount();
+private:
+	void renderLanes(float* left, float* right);
+	unsigned sampleRate;
+	SynthVoice voices[SYNTH_MAX_VOICES];
+	alignas(32) float spillLeft[SYNTH_LANES]; // rendered past the last request, used first next time
+	alignas(32) float spillRight[SYNTH_LANES];
+	int spillCount;
+	float noise[SYNTH_NOISE_SIZE + SYNTH_LANES]; // wraps around, so a lane block always reads in one piece
+};
+
+SynthVoices::SynthVoices(unsigned sampleRate) {
+	this->sampleRate = sampleRate;
+	uint32_t seed = 1;
+	for (int i = 0; i < SYNTH_NOISE_SIZE; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		this->noise[i] = (float)(int32_t)seed * (1.0f / 2147483648.0f);
+	}
+	for (int i = 0; i < SYNTH_LANES; i++) {
+		this->noise[SYNTH_NOISE_SIZE + i] = this->noise[i];
+	}
+	this->reset();
+}
+
+void SynthVoices::reset() {
+	for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+		memset(&this->voices[v], 0, sizeof(SynthVoice));
+	}
+	this->spillCount = 0;
+}
+
+int SynthVoices::getActiveCount() {
+	int count = 0;
+	for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+		count += this->voices[v].amp > 0.0f ? 1 : 0;
+	}
+	return count;
+}
+
+void SynthVoices::trigger(const SynthEvent& event) {
+	// 0 at the serve speed, 1 after about three doublings
+	float speed = max(0.0f, min(1.0f, log2(max(event.speed, 0.1f) / 0.4f) / 3.0f));
+
+	float frequency;
+	float octaves; // glide over the sound's length
+	float seconds; // time to fall 60 dB
+	float volume;
+	float noise;
+	if (event.sound == SYNTH_IMPACT) {
+		// deeper off the middle of the paddle, brighter off the edges
+		frequency = 196.0f * pow(2.0f, speed * 1.5f) * (1.0f + 0.35f * abs(event.offset));
+		octaves = -0.5f;
+		seconds = 0.12f;
+		volume = 0.2f + 0.3f * speed;
+		noise = 0.15f;
+	}
+	else if (event.sound == SYNTH_WALL) {
+		frequency = 392.0f * pow(2.0f, speed);
+		octaves = 0.0f;
+		seconds = 0.05f;
+		volume = 0.08f + 0.15f * speed;
+		noise = 0.4f;
+	}
+	else {
+		frequency = 440.0f;
+		octaves = 2.0f;
+		seconds = 0.4f;
+		volume = 0.25f;
+		noise = 0.0f;
+	}
+
+	// a free voice, or the quietest one
+	int slot = 0;
+	for (int v = 1; v < SYNTH_MAX_VOICES; v++) {
+		if (this->voices[v].amp < this->voices[slot].amp) {
+			slot = v;
+		}
+	}
+	SynthVoice& voice = this->voices[slot];
+	float samples = seconds * this->sampleRate;
+	float decay = pow(0.001f, 1.0f / samples);
+	voice.phase = 0.0f;
+	voice.step = 2.0f * frequency / this->sampleRate;
+	voice.sweep = pow(2.0f, octaves * SYNTH_LANES / samples);
+	voice.amp = 1.0f;
+	voice.decay = pow(decay, (float)SYNTH_LANES);
+	for (int k = 0; k < SYNTH_LANES; k++) {
+		voice.decayLanes[k] = pow(decay, (float)k);
+	}
+	voice.gainLeft = volume * sqrt((1.0f - event.pan) / 2.0f); // equal power pan
+	voice.gainRight = volume * sqrt((1.0f + event.pan) / 2.0f);
+	voice.noise = noise;
+	voice.noisePosition = (uint32_t)slot * 7919u % SYNTH_NOISE_SIZE;
+}
+
+// adds the next 8 samples of every voice
+void SynthVoices::renderLanes(float* left, float* right) {
+	// lanes summed in locals, stores through left and right could alias the voices and stop vectorization
+	alignas(32) float laneLeft[SYNTH_LANES] = { 0.0f };
+	alignas(32) float laneRight[SYNTH_LANES] = { 0.0f };
+	for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+		SynthVoice& voice = this->voices[v];
+		if (voice.amp <= 0.0f) {
+			continue;
+		}
+		const float phase = voice.phase;
+		const float step = voice.step;
+		const float amp = voice.amp;
+		const float noise = voice.noise;
+		const float gainLeft = voice.gainLeft;
+		const float gainRight = voice.gainRight;
+		const float* white = this->noise + voice.noisePosition;
+		const float* envelope = voice.decayLanes;
+		for (int k = 0; k < SYNTH_LANES; k++) {
+			// phase stays in -1..1, a lane block never moves it by a whole period
+			float p = phase + (float)k * step;
+			p -= 2.0f * (float)(int)((p + 1.0f) * 0.5f); // wraps without a branch, which would stop vectorizing
+			float tone = 4.0f * p * (1.0f - abs(p)); // parabolic sine
+			float sample = (tone + noise * (white[k] - tone)) * amp * envelope[k];
+			laneLeft[k] += sample * gainLeft;
+			laneRight[k] += sample * gainRight;
+		}
+		float next = phase + SYNTH_LANES * step;
+		voice.phase = next >= 1.0f ? next - 2.0f : next;
+		voice.step = min(step * voice.sweep, 1.0f / SYNTH_LANES); // keeps the single wrap above valid, about 2.7 kHz
+		voice.amp = amp * voice.decay;
+		voice.noisePosition = (voice.noisePosition + SYNTH_LANES) % SYNTH_NOISE_SIZE;
+		if (voice.amp < 0.0001f) {
+			voice.amp = 0.0f; // faded out, the slot is free
+		}
+	}
+	for (int k = 0; k < SYNTH_LANES; k++) {
+		left[k] += laneLeft[k];
+		right[k] += laneRight[k];
+	}
+}
+
+// adds frames of every voice to planar left and right buffers
+void SynthVoices::render(float* left, float* right, int frames) {
+	int done = 0;
+	while (done < frames) {
+		if (this->spillCount == 0) {
+			memset(this->spillLeft, 0, sizeof(this->spillLeft));
+			memset(this->spillRight, 0, sizeof(this->spillRight));
+			this->renderLanes(this->spillLeft, this->spillRight);
+			this->spillCount = SYNTH_LANES;
+		}
+		if (this->spillCount == SYNTH_LANES && frames - done >= SYNTH_LANES) {
+			// whole lane blocks straight into the output
+			for (int k = 0; k < SYNTH_LANES; k++) {
+				left[done + k] += this->spillLeft[k];
+				right[done + k] += this->spillRight[k];
+			}
+			done += SYNTH_LANES;
+			this->spillCount = 0;
+			continue;
+		}
+		int first = SYNTH_LANES - this->spillCount;
+		int count = min(this->spillCount, frames - done);
+		for (int k = 0; k < count; k++) {
+			left[done + k] += this->spillLeft[first + k];
+			right[done + k] += this->spillRight[first + k];
+		}
+		done += count;
+		this->spillCount -= count;
+	}
+}
+
+class Synth : public SoundStream {
+public:
+	Synth();
+	~Synth();
+	void trigger(const SynthEvent& event);
+	float getLoad();
+	int64_t getMaxBlockUs();
+	uint32_t getUnderruns();
+	uint32_t getBlocks();
+protected:
+	bool onGetData(Chunk& data);
+	void onSeek(Time timeOffset);
+private:
+	// game thread writes events at the head, audio thread reads them at the tail
+	SynthEvent queue[SYNTH_QUEUE_SIZE];
+	atomic<uint32_t> queueHead;
+	atomic<uint32_t> queueTail;
+
+	// audio thread
+	SynthVoices voices;
+	alignas(32) float left[SYNTH_BLOCK_FRAMES];
+	alignas(32) float right[SYNTH_BLOCK_FRAMES];
+	Int16 samples[SYNTH_BLOCK_FRAMES * SYNTH_CHANNELS];
+	chrono::steady_clock::time_point playStart;
+	uint64_t framesStreamed;
+
+	// stats, read from the game thread
+	atomic<uint32_t> blocks;
+	atomic<int64_t> busyUs;
+	atomic<int64_t> maxBlockUs;
+	atomic<uint32_t> underruns;
+};
+
+Synth::Synth() : queueHead(0), queueTail(0), voices(SYNTH_SAMPLE_RATE), blocks(0), busyUs(0), maxBlockUs(0), underruns(0) {
+	this->framesStreamed = 0;
+	this->initialize(SYNTH_CHANNELS, SYNTH_SAMPLE_RATE);
+}
+
+Synth::~Synth() {
+	this->stop(); // the audio thread must be gone before the buffers are
+}
+
+void Synth::trigger(const SynthEvent& event) {
+	uint32_t head = this->queueHead.load(memory_order_relaxed);
+	if (head - this->queueTail.load(memory_order_acquire) == SYNTH_QUEUE_SIZE) {
+		return; // audio thread is behind, the sound is lost
+	}
+	this->queue[head % SYNTH_QUEUE_SIZE] = event;
+	this->queueHead.store(head + 1, memory_order_release);
+}
+
+bool Synth::onGetData(Chunk& data) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// the sound card underran if more time has passed since playing began than audio was handed over,
+	// the first blocks are queued before playback starts so the count begins with some headroom
+	if (this->framesStreamed == 0) {
+		this->playStart = start;
+	}
+	else {
+		int64_t playedUs = chrono::duration_cast<chrono::microseconds>(start - this->playStart).count();
+		int64_t streamedUs = (int64_t)(this->framesStreamed * 1000000 / SYNTH_SAMPLE_RATE);
+		if (playedUs > streamedUs) {
+			// count each gap once, then assume the usual blocks are queued again so that ordinary
+			// callback jitter (SFML polls every 10 ms) isn't counted as more underruns
+			int64_t headroomUs = (int64_t)SYNTH_HEADROOM_BLOCKS * SYNTH_BLOCK_FRAMES * 1000000 / SYNTH_SAMPLE_RATE;
+			this->underruns++;
+			this->playStart = start - chrono::microseconds(max((int64_t)0, streamedUs - headroomUs));
+		}
+	}
+
+	uint32_t tail = this->queueTail.load(memory_order_relaxed);
+	uint32_t head = this->queueHead.load(memory_order_acquire);
+	for (; tail != head; tail++) {
+		this->voices.trigger(this->queue[tail % SYNTH_QUEUE_SIZE]);
+	}
+	this->queueTail.store(tail, memory_order_release);
+
+	memset(this->left, 0, sizeof(this->left));
+	memset(this->right, 0, sizeof(this->right));
+	this->voices.render(this->left, this->right, SYNTH_BLOCK_FRAMES);
+	for (int i = 0; i < SYNTH_BLOCK_FRAMES; i++) {
+		this->samples[i * 2] = (Int16)(max(-1.0f, min(1.0f, this->left[i])) * 32767.0f);
+		this->samples[i * 2 + 1] = (Int16)(max(-1.0f, min(1.0f, this->right[i])) * 32767.0f);
+	}
+	data.samples = this->samples;
+	data.sampleCount = SYNTH_BLOCK_FRAMES * SYNTH_CHANNELS;
+	this->framesStreamed += SYNTH_BLOCK_FRAMES;
+
+	int64_t us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	this->busyUs += us;
+	if (us > this->maxBlockUs) {
+		this->maxBlockUs = us; // only this thread writes it
+	}
+	this->blocks++;
+	return true; // never ends
+}
+
+void Synth::onSeek(Time) {
+	// nothing to seek, stopping starts the underrun count over
+	this->framesStreamed = 0;
+}
+
+// fraction of real time the audio thread spends synthesizing
+float Synth::getLoad() {
+	uint32_t blocks = this->blocks;
+	if (blocks == 0) {
+		return 0.0f;
+	}
+	return (float)((double)this->busyUs / (blocks * (SYNTH_BLOCK_FRAMES * 1000000.0 / SYNTH_SAMPLE_RATE)));
+}
+
+int64_t Synth::getMaxBlockUs() {
+	return this->maxBlockUs;
+}
+
+uint32_t Synth::getUnderruns() {
+	return this->underruns;
+}
+
+uint32_t Synth::getBlocks() {
+	return this->blocks;
+}
+
+/*
+Frame capture for SFML Pong
+Records rendered frames to a Y4M video (filename ending in .y4m) or a numbered PPM image sequence, with a WAV of the
+game audio next to it. Frames are read back through a ring of OpenGL pixel buffers, so the copy finishes on the GPU
+while later frames are drawn, into a fixed pool of frame buffers that a writer thread converts and streams to disk.
+When the pool is full, live capture drops the frame and the writer repeats the previous one to keep audio in step.
+Headless capture waits for the writer instead, since nothing is on screen to stall.
+Every frame in the file stands for 1/60 s. Live play is timed by the wall clock with grabAt, which leaves out frames
+drawn faster than that and holds the previous frame over any that were missed, so menus and pauses keep their length.
+*/
+const int CAPTURE_POOL_FRAMES = 8; // 2 MB each at 1024x512
+const int CAPTURE_PBO_COUNT = 3; // frames in flight on the GPU
+const int CAPTURE_FPS = 60;
+const int CAPTURE_MAX_SOUNDS = 8; // sound events per frame
+const unsigned CAPTURE_SAMPLE_RATE = SYNTH_SAMPLE_RATE;
+const unsigned CAPTURE_CHANNELS = 2;
+const int CAPTURE_FRAME_SAMPLES = CAPTURE_SAMPLE_RATE / CAPTURE_FPS; // per channel
+
+enum CapturePolicy {
+	CAPTURE_DROP, // never block the caller, for live play
+	CAPTURE_WAIT // block until the writer frees a buffer, for headless capture
+};
+
+// pixel buffer objects are OpenGL 2.1, loaded at runtime since the system headers may only cover 1.1
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+typedef void (APIENTRY *CaptureGenBuffers)(GLsizei count, GLuint* buffers);
+typedef void (APIENTRY *CaptureDeleteBuffers)(GLsizei count, const GLuint* buffers);
+typedef void (APIENTRY *CaptureBindBuffer)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *CaptureBufferData)(GLenum target, ptrdiff_t size, const void* data, GLenum usage);
+typedef void* (APIENTRY *CaptureMapBuffer)(GLenum target, GLenum access);
+typedef GLboolean (APIENTRY *CaptureUnmapBuffer)(GLenum target);
+
+struct CaptureFrame {
+	vector<uint8_t> pixels; // RGBA
+	uint32_t index; // frame number, gaps are dropped frames
+	int soundCount;
+	SynthEvent sounds[CAPTURE_MAX_SOUNDS];
+};
+
+class FrameCapture {
+public:
+	FrameCapture();
+	~FrameCapture();
+	void setMusic(string musicFile);
+	bool open(string filename, int width, int height, CapturePolicy policy);
+	bool isOpen();
+	void addSound(const SynthEvent& sound);
+	void grab();
+	void grabAt(int64_t elapsedUs);
+	void close();
+	uint32_t getFramesWritten();
+	uint32_t getFramesDropped();
+private:
+	bool loadPixelBuffers();
+	void submit(const uint8_t* pixels, uint32_t index, const SynthEvent* sounds, int soundCount);
+	void writeLoop();
+	void writeVideo(const CaptureFrame* frame, bool repeat);
+	void writeAudio(const SynthEvent* sounds, int soundCount);
+	int width;
+	int height;
+	CapturePolicy policy;
+	bool y4m;
+	string filename;
+	bool opened;
+
+	// render thread
+	uint32_t frameIndex;
+	SynthEvent pendingSounds[CAPTURE_MAX_SOUNDS];
+	int pendingSoundCount;
+
+	// pixel buffer ring, each holds a frame index and its sounds until it is read back
+	bool pboLoaded;
+	bool pboAvailable;
+	GLuint pbos[CAPTURE_PBO_COUNT];
+	uint32_t pboIndex[CAPTURE_PBO_COUNT];
+	SynthEvent pboSounds[CAPTURE_PBO_COUNT][CAPTURE_MAX_SOUNDS];
+	int pboSoundCount[CAPTURE_PBO_COUNT];
+	uint32_t pboHead;
+	uint32_t pboTail;
+	CaptureGenBuffers genBuffers;
+	CaptureDeleteBuffers deleteBuffers;
+	CaptureBindBuffer bindBuffer;
+	CaptureBufferData bufferData;
+	CaptureMapBuffer mapBuffer;
+	CaptureUnmapBuffer unmapBuffer;
+
+	// pool, frames move between the free list and the writer's queue
+	CaptureFrame frames[CAPTURE_POOL_FRAMES];
+	vector<int> freeFrames;
+	vector<int> filledFrames; // oldest first
+	mutex lock;
+	condition_variable frameFilled;
+	condition_variable frameFreed;
+	bool closing;
+	uint32_t endIndex; // frames grabbed in total, known once closing
+	thread writer;
+	atomic<uint32_t> written;
+	atomic<uint32_t> dropped;
+
+	// writer thread
+	ofstream video;
+	vector<uint8_t> converted; // last frame as written, repeated over dropped frames
+	uint32_t nextIndex;
+	unique_ptr<OutputSoundFile> audio; // reset to finish the file
+	string musicFile;
+	InputSoundFile music;
+	bool musicOpen;
+	vector<Int16> musicSamples;
+	double musicPosition; // source frames played so far, fractional when resampling
+	SynthVoices voices; // same synth as live play, fed the events each frame recorded
+	float voiceLeft[CAPTURE_FRAME_SAMPLES];
+	float voiceRight[CAPTURE_FRAME_SAMPLES];
+	int32_t mix[CAPTURE_FRAME_SAMPLES * CAPTURE_CHANNELS];
+	Int16 mixOut[CAPTURE_FRAME_SAMPLES * CAPTURE_CHANNELS];
+};
+
+FrameCapture::FrameCapture() : written(0), dropped(0), voices(CAPTURE_SAMPLE_RATE) {
+	this->width = 0;
+	this->height = 0;
+	this->policy = CAPTURE_DROP;
+	this->y4m = true;
+	this->opened = false;
+	this->closing = false;
+	this->endIndex = 0;
+	this->frameIndex = 0;
+	this->pendingSoundCount = 0;
+	this->pboLoaded = false;
+	this->pboAvailable = false;
+	this->pboHead = 0;
+	this->pboTail = 0;
+	this->nextIndex = 0;
+	this->musicOpen = false;
+	this->musicPosition = 0.0;
+}
+
+FrameCapture::~FrameCapture() {
+	this->close();
+}
+
+void FrameCapture::setMusic(string musicFile) {
+	// sound effects are synthesized where the game played them, music loops underneath
+	this->musicFile = musicFile;
+}
+
+bool FrameCapture::open(string filename, int width, int height, CapturePolicy policy) {
+	this->close();
+	this->width = width;
+	this->height = height;
+	this->policy = policy;
+	this->filename = filename;
+	this->y4m = filename.size() > 4 && filename.substr(filename.size() - 4) == ".y4m";
+
+	string base = filename;
+	if (this->y4m) {
+		base = filename.substr(0, filename.size() - 4);
+		this->video.open(filename, ios::binary);
+		if (!this->video) {
+			return false;
+		}
+		// full range BT.601 4:2:0, what C420jpeg means to most players
+		this->video << "YUV4MPEG2 W" << width << " H" << height << " F" << CAPTURE_FPS << ":1 Ip A1:1 C420jpeg\n";
+		this->converted.assign(width * height * 3 / 2, 128);
+		fill(this->converted.begin(), this->converted.begin() + width * height, 0); // black until the first frame arrives
+	}
+	else {
+		this->converted.assign(width * height * 3, 0);
+	}
+
+	this->audio.reset(new OutputSoundFile());
+	if (!this->audio->openFromFile(base + ".wav", CAPTURE_SAMPLE_RATE, CAPTURE_CHANNELS)) {
+		cerr << "Could not open " << base << ".wav, capturing without audio" << endl;
+		this->audio.reset();
+	}
+	this->musicOpen = this->musicFile != "" && this->music.openFromFile(this->musicFile);
+	this->musicPosition = 0.0;
+	if (this->musicOpen) {
+		double step = (double)this->music.getSampleRate() / CAPTURE_SAMPLE_RATE;
+		this->musicSamples.reserve(((size_t)(step * CAPTURE_FRAME_SAMPLES) + 1) * this->music.getChannelCount());
+	}
+	this->voices.reset();
+
+	// every buffer is allocated here, capture itself never allocates
+	this->freeFrames.clear();
+	this->filledFrames.clear();
+	this->freeFrames.reserve(CAPTURE_POOL_FRAMES);
+	this->filledFrames.reserve(CAPTURE_POOL_FRAMES);
+	for (int i = 0; i < CAPTURE_POOL_FRAMES; i++) {
+		this->frames[i].pixels.assign((size_t)width * height * 4, 0);
+		this->freeFrames.push_back(i);
+	}
+
+	this->frameIndex = 0;
+	this->nextIndex = 0;
+	this->pendingSoundCount = 0;
+	this->pboHead = 0;
+	this->pboTail = 0;
+	this->written = 0;
+	this->dropped = 0;
+	this->closing = false;
+	this->opened = true;
+	this->writer = thread(&FrameCapture::writeLoop, this);
+	return true;
+}
+
+bool FrameCapture::isOpen() {
+	return this->opened;
+}
+
+bool FrameCapture::loadPixelBuffers() {
+	// needs the capturing context to be active
+	this->genBuffers = (CaptureGenBuffers)Context::getFunction("glGenBuffers");
+	this->deleteBuffers = (CaptureDeleteBuffers)Context::getFunction("glDeleteBuffers");
+	this->bindBuffer = (CaptureBindBuffer)Context::getFunction("glBindBuffer");
+	this->bufferData = (CaptureBufferData)Context::getFunction("glBufferData");
+	this->mapBuffer = (CaptureMapBuffer)Context::getFunction("glMapBuffer");
+	this->unmapBuffer = (CaptureUnmapBuffer)Context::getFunction("glUnmapBuffer");
+	if (this->genBuffers == nullptr || this->deleteBuffers == nullptr || this->bindBuffer == nullptr ||
+		this->bufferData == nullptr || this->mapBuffer == nullptr || this->unmapBuffer == nullptr) {
+		return false;
+	}
+	this->genBuffers(CAPTURE_PBO_COUNT, this->pbos);
+	for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+		this->bindBuffer(GL_PIXEL_PACK_BUFFER, this->pbos[i]);
+		this->bufferData(GL_PIXEL_PACK_BUFFER, (ptrdiff_t)this->width * this->height * 4, nullptr, GL_STREAM_READ);
+	}
+	this->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+void FrameCapture::addSound(const SynthEvent& sound) {
+	if (this->pendingSoundCount < CAPTURE_MAX_SOUNDS) {
+		this->pendingSounds[this->pendingSoundCount++] = sound;
+	}
+}
+
+// reads back the frame just drawn, call after drawing and before display with the target's context active
+void FrameCapture::grab() {
+	if (!this->opened) {
+		return;
+	}
+	if (!this->pboLoaded) {
+		this->pboAvailable = this->loadPixelBuffers();
+		this->pboLoaded = true;
+		if (!this->pboAvailable) {
+			cerr << "Pixel buffers unavailable, frame capture reads back synchronously" << endl;
+		}
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	if (!this->pboAvailable) {
+		// no pixel buffers, read straight into a pooled frame, still never touching the disk here
+		int slot = -1;
+		{
+			unique_lock<mutex> guard(this->lock);
+			if (this->policy == CAPTURE_WAIT) {
+				this->frameFreed.wait(guard, [this]() { return !this->freeFrames.empty(); });
+			}
+			if (!this->freeFrames.empty()) {
+				slot = this->freeFrames.back();
+				this->freeFrames.pop_back();
+			}
+		}
+		if (slot < 0) {
+			this->dropped++; // the pending sounds carry over to the next frame
+			this->frameIndex++;
+			return;
+		}
+		CaptureFrame* frame = &this->frames[slot];
+		glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, frame->pixels.data());
+		frame->index = this->frameIndex++;
+		frame->soundCount = this->pendingSoundCount;
+		memcpy(frame->sounds, this->pendingSounds, this->pendingSoundCount * sizeof(SynthEvent));
+		this->pendingSoundCount = 0;
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->filledFrames.push_back(slot);
+		}
+		this->frameFilled.notify_one();
+		return;
+	}
+
+	// start this frame's copy, it completes on the GPU while the next frames are drawn
+	int head = this->pboHead % CAPTURE_PBO_COUNT;
+	this->bindBuffer(GL_PIXEL_PACK_BUFFER, this->pbos[head]);
+	glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	this->pboIndex[head] = this->frameIndex++;
+	this->pboSoundCount[head] = this->pendingSoundCount;
+	memcpy(this->pboSounds[head], this->pendingSounds, this->pendingSoundCount * sizeof(SynthEvent));
+	this->pendingSoundCount = 0;
+	this->pboHead++;
+
+	// collect the oldest copy once the ring is full, it was issued frames ago and is ready
+	if (this->pboHead - this->pboTail == CAPTURE_PBO_COUNT) {
+		int tail = this->pboTail % CAPTURE_PBO_COUNT;
+		this->bindBuffer(GL_PIXEL_PACK_BUFFER, this->pbos[tail]);
+		const uint8_t* pixels = (const uint8_t*)this->mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		if (pixels != nullptr) {
+			this->submit(pixels, this->pboIndex[tail], this->pboSounds[tail], this->pboSoundCount[tail]);
+			this->unmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		this->pboTail++;
+	}
+	this->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// grab() for live play, elapsedUs counts from when capture started
+void FrameCapture::grabAt(int64_t elapsedUs) {
+	if (!this->opened) {
+		return;
+	}
+	uint32_t due = (uint32_t)(elapsedUs * CAPTURE_FPS / 1000000); // the video frame on screen at elapsedUs
+	if (due < this->frameIndex) {
+		return; // that frame was already grabbed, the display runs faster than the video
+	}
+	this->frameIndex = due; // the writer fills any frames skipped over with the last one grabbed
+	this->grab();
+}
+
+void FrameCapture::submit(const uint8_t* pixels, uint32_t index, const SynthEvent* sounds, int soundCount) {
+	int slot = -1;
+	{
+		unique_lock<mutex> guard(this->lock);
+		if (this->policy == CAPTURE_WAIT) {
+			this->frameFreed.wait(guard, [this]() { return !this->freeFrames.empty(); });
+		}
+		if (!this->freeFrames.empty()) {
+			slot = this->freeFrames.back();
+			this->freeFrames.pop_back();
+		}
+	}
+	if (slot < 0) {
+		// writer is behind, drop this frame and keep its sounds for the next one
+		this->dropped++;
+		for (int i = 0; i < soundCount && this->pendingSoundCount < CAPTURE_MAX_SOUNDS; i++) {
+			this->pendingSounds[this->pendingSoundCount++] = sounds[i];
+		}
+		return;
+	}
+
+	CaptureFrame* frame = &this->frames[slot];
+	memcpy(frame->pixels.data(), pixels, frame->pixels.size());
+	frame->index = index;
+	frame->soundCount = soundCount;
+	memcpy(frame->sounds, sounds, soundCount * sizeof(SynthEvent));
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->filledFrames.push_back(slot);
+	}
+	this->frameFilled.notify_one();
+}
+
+void FrameCapture::close() {
+	if (!this->opened) {
+		return;
+	}
+	// collect copies still on the GPU, the context is still active on the caller
+	if (this->pboAvailable) {
+		while (this->pboTail != this->pboHead) {
+			int tail = this->pboTail % CAPTURE_PBO_COUNT;
+			this->bindBuffer(GL_PIXEL_PACK_BUFFER, this->pbos[tail]);
+			const uint8_t* pixels = (const uint8_t*)this->mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+			if (pixels != nullptr) {
+				this->policy = CAPTURE_WAIT; // the last frames are worth waiting for
+				this->submit(pixels, this->pboIndex[tail], this->pboSounds[tail], this->pboSoundCount[tail]);
+				this->unmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			this->pboTail++;
+		}
+		this->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		this->deleteBuffers(CAPTURE_PBO_COUNT, this->pbos);
+	}
+	this->pboLoaded = false;
+	this->pboAvailable = false;
+
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->closing = true;
+		this->endIndex = this->frameIndex;
+	}
+	this->frameFilled.notify_one();
+	this->writer.join();
+	this->video.close();
+	this->audio.reset(); // finishes the WAV header
+	this->opened = false;
+}
+
+uint32_t FrameCapture::getFramesWritten() {
+	return this->written;
+}
+
+uint32_t FrameCapture::getFramesDropped() {
+	return this->dropped;
+}
+
+void FrameCapture::writeLoop() {
+	while (true) {
+		int slot;
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->frameFilled.wait(guard, [this]() { return this->closing || !this->filledFrames.empty(); });
+			slot = this->filledFrames.empty() ? -1 : this->filledFrames.front();
+			if (slot >= 0) {
+				this->filledFrames.erase(this->filledFrames.begin());
+			}
+		}
+
+		// fill gaps left by dropped frames with the last frame, audio carries on underneath
+		uint32_t index = slot >= 0 ? this->frames[slot].index : this->endIndex;
+		while (this->nextIndex < index) {
+			this->writeVideo(nullptr, true);
+			this->writeAudio(nullptr, 0);
+			this->nextIndex++;
+		}
+		if (slot < 0) {
+			return; // closing with everything written
+		}
+		CaptureFrame* frame = &this->frames[slot];
+		this->writeVideo(frame, false);
+		this->writeAudio(frame->sounds, frame->soundCount);
+		this->nextIndex = frame->index + 1;
+		this->written++;
+
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->freeFrames.push_back(slot);
+		}
+		this->frameFreed.notify_one();
+	}
+}
+
+void FrameCapture::writeVideo(const CaptureFrame* frame, bool repeat) {
+	int w = this->width;
+	int h = this->height;
+	uint8_t* out = this->converted.data();
+	if (!repeat) {
+		// OpenGL reads the bottom row first, so rows are flipped on the way out
+		const uint8_t* pixels = frame->pixels.data();
+		if (this->y4m) {
+			// luma per pixel, chroma averaged over 2x2 blocks
+			uint8_t* yPlane = out;
+			uint8_t* uPlane = out + w * h;
+			uint8_t* vPlane = uPlane + (w / 2) * (h / 2);
+			for (int y = 0; y < h; y++) {
+				const uint8_t* row = pixels + (h - 1 - y) * w * 4;
+				for (int x = 0; x < w; x++) {
+					int r = row[x * 4];
+					int g = row[x * 4 + 1];
+					int b = row[x * 4 + 2];
+					yPlane[y * w + x] = (uint8_t)((77 * r + 150 * g + 29 * b) >> 8);
+				}
+			}
+			for (int y = 0; y < h / 2; y++) {
+				const uint8_t* row0 = pixels + (h - 1 - 2 * y) * w * 4;
+				const uint8_t* row1 = pixels + (h - 2 - 2 * y) * w * 4;
+				for (int x = 0; x < w / 2; x++) {
+					int r = row0[x * 8] + row0[x * 8 + 4] + row1[x * 8] + row1[x * 8 + 4];
+					int g = row0[x * 8 + 1] + row0[x * 8 + 5] + row1[x * 8 + 1] + row1[x * 8 + 5];
+					int b = row0[x * 8 + 2] + row0[x * 8 + 6] + row1[x * 8 + 2] + row1[x * 8 + 6];
+					uPlane[y * (w / 2) + x] = (uint8_t)(((-43 * r - 85 * g + 128 * b) >> 10) + 128);
+					vPlane[y * (w / 2) + x] = (uint8_t)(((128 * r - 107 * g - 21 * b) >> 10) + 128);
+				}
+			}
+		}
+		else {
+			for (int y = 0; y < h; y++) {
+				const uint8_t* row = pixels + (h - 1 - y) * w * 4;
+				for (int x = 0; x < w; x++) {
+					out[(y * w + x) * 3] = row[x * 4];
+					out[(y * w + x) * 3 + 1] = row[x * 4 + 1];
+					out[(y * w + x) * 3 + 2] = row[x * 4 + 2];
+				}
+			}
+		}
+	}
+
+	if (this->y4m) {
+		this->video << "FRAME\n";
+		this->video.write((const char*)out, this->converted.size());
+	}
+	else {
+		char name[32];
+		snprintf(name, sizeof(name), "_%06u.ppm", this->nextIndex);
+		ofstream image(this->filename + name, ios::binary);
+		image << "P6\n" << w << " " << h << "\n255\n";
+		image.write((const char*)out, this->converted.size());
+	}
+}
+
+void FrameCapture::writeAudio(const SynthEvent* sounds, int soundCount) {
+	if (!this->audio) {
+		return;
+	}
+	memset(this->mix, 0, sizeof(this->mix));
+
+	// music, nearest sample resampled to the capture rate and looped, each frame reads on from where the last stopped
+	if (this->musicOpen && this->music.getSampleRate() > 0 && this->music.getChannelCount() > 0) {
+		unsigned channels = this->music.getChannelCount();
+		double step = (double)this->music.getSampleRate() / CAPTURE_SAMPLE_RATE;
+		double base = floor(this->musicPosition);
+		size_t count = (size_t)(floor(this->musicPosition + step * CAPTURE_FRAME_SAMPLES) - base);
+		this->musicSamples.resize(count * channels);
+		size_t got = (size_t)this->music.read(this->musicSamples.data(), count * channels) / channels;
+		if (got < count) {
+			this->music.seek(0);
+			got += (size_t)this->music.read(this->musicSamples.data() + got * channels, (count - got) * channels) / channels;
+		}
+		for (int s = 0; s < CAPTURE_FRAME_SAMPLES && got > 0; s++) {
+			size_t source = min(got - 1, (size_t)(floor(this->musicPosition + s * step) - base));
+			for (unsigned c = 0; c < CAPTURE_CHANNELS; c++) {
+				this->mix[s * CAPTURE_CHANNELS + c] += this->musicSamples[source * channels + min(c, channels - 1)];
+			}
+		}
+		this->musicPosition += step * CAPTURE_FRAME_SAMPLES;
+	}
+
+	// start this frame's sounds, then mix every voice still playing
+	for (int i = 0; i < soundCount; i++) {
+		this->voices.trigger(sounds[i]);
+	}
+	memset(this->voiceLeft, 0, sizeof(this->voiceLeft));
+	memset(this->voiceRight, 0, sizeof(this->voiceRight));
+	this->voices.render(this->voiceLeft, this->voiceRight, CAPTURE_FRAME_SAMPLES);
+	for (int s = 0; s < CAPTURE_FRAME_SAMPLES; s++) {
+		this->mix[s * CAPTURE_CHANNELS] += (int32_t)(this->voiceLeft[s] * 32767.0f);
+		this->mix[s * CAPTURE_CHANNELS + 1] += (int32_t)(this->voiceRight[s] * 32767.0f);
+	}
+
+	for (int i = 0; i < CAPTURE_FRAME_SAMPLES * (int)CAPTURE_CHANNELS; i++) {
+		this->mixOut[i] = (Int16)max(-32768, min(32767, this->mix[i]));
+	}
+	this->audio->write(this->mixOut, CAPTURE_FRAME_SAMPLES * CAPTURE_CHANNELS);
+}
+
+/*
+Ball pool for SFML Pong
+Every ball the game can have is built up front, spawning and removing balls during play only moves indices around.
+Active balls keep the order they were spawned in, so the paddles always track the oldest ball in play.
+*/
+const int MAX_BALLS = 256;
+
+class BallPool {
+public:
+	BallPool(int capacity);
+	Ball* spawn();
+	void release(int i);
+	void clear();
+	int getCount();
+	Ball* get(int i);
+private:
+	vector<Ball> balls;
+	vector<int> active;
+	vector<int> freeSlots;
+};
+
+BallPool::BallPool(int capacity) {
+	// velocity given so building the pool does not use up random numbers
+	this->balls.assign(capacity, Ball(Vector2f(-100.0f, 0), Vector2f(0.0f, 0.0f)));
+	this->active.reserve(capacity);
+	this->freeSlots.reserve(capacity);
+	this->clear();
+}
+
+Ball* BallPool::spawn() {
+	// returns null when the pool is used up
+	if (this->freeSlots.empty()) {
+		return nullptr;
+	}
+	int slot = this->freeSlots.back();
+	this->freeSlots.pop_back();
+	this->active.push_back(slot);
+
+	Ball* ball = &this->balls[slot];
+	ball->setActive(true);
+	ball->setRadius(5.0f);
+	ball->setLastHit(0);
+	return ball;
+}
+
+void BallPool::release(int i) {
+	int slot = this->active[i];
+	this->balls[slot].setActive(false);
+	this->balls[slot].setVelocity(Vector2f(0.0f, 0.0f));
+	this->active.erase(this->active.begin() + i); // keeps spawn order, O(active balls)
+	this->freeSlots.push_back(slot);
+}
+
+void BallPool::clear() {
+	this->active.clear();
+	this->freeSlots.clear();
+	for (int i = (int)this->balls.size() - 1; i >= 0; i--) {
+		this->balls[i].setActive(false);
+		this->freeSlots.push_back(i);
+	}
+}
+
+int BallPool::getCount() {
+	return (int)this->active.size();
+}
+
+Ball* BallPool::get(int i) {
+	return &this->balls[this->active[i]];
+}
+
+/*
+Powerup system for SFML Pong
+Spawns powerups from a schedule read from a config file, see powerups.cfg for the format.
+Powerups come out of a fixed pool and timed effects (grow, shrink, speed) sit in a fixed array until they run out,
+so nothing is allocated during play and each tick only touches the effects that are running.
+Applying and undoing effects is up to the Game, which owns the balls and paddles.
+*/
+const int MAX_POWERUPS = 512;
+const int MAX_EFFECTS = 256;
+const float MIN_POWERUP_REPEAT = 1.0f; // ms, shorter repeats would respawn forever within one tick
+
+struct PowerUpSpawn {
+	float time; // ms after the serve
+	float x; // fraction of the window width
+	float y; // fraction of the window height
+	PowerUpEffect effect;
+	float amount;
+	float duration; // ms, timed effects only
+	float repeat; // ms between respawns, 0 to spawn once per serve
+};
+
+struct ActiveEffect {
+	PowerUpEffect effect;
+	float amount;
+	float remaining;
+	int target; // paddle side for grow and shrink
+};
+
+class PowerUpSystem {
+public:
+	PowerUpSystem();
+	bool loadConfig(string filename);
+	void useDefaults();
+	void startServe();
+	void clear();
+	void update(float dt);
+	int getCount();
+	PowerUp* get(int i);
+	void remove(int i);
+	bool addEffect(PowerUpEffect effect, float amount, float duration, int target);
+	int getEffectCount();
+	int getExpiredCount();
+	ActiveEffect* getExpired(int i);
+private:
+	void setSchedule(vector<PowerUpSpawn> schedule);
+	vector<PowerUpSpawn> schedule;
+	vector<pair<float, int>> queue; // min-heap of (next spawn time, schedule index)
+	float serveTime;
+	vector<PowerUp> pool;
+	vector<int> active;
+	vector<int> freeSlots;
+	ActiveEffect effects[MAX_EFFECTS];
+	int effectCount;
+	ActiveEffect expired[MAX_EFFECTS]; // effects that ran out this tick
+	int expiredCount;
+};
+
+PowerUpSystem::PowerUpSystem() {
+	this->pool.resize(MAX_POWERUPS);
+	this->active.reserve(MAX_POWERUPS);
+	this->freeSlots.reserve(MAX_POWERUPS);
+	this->effectCount = 0;
+	this->expiredCount = 0;
+	this->serveTime = 0.0f;
+	this->useDefaults();
+}
+
+bool PowerUpSystem::loadConfig(string filename) {
+	ifstream file(filename);
+	if (!file) {
+		return false;
+	}
+
+	const char* names[EFFECT_COUNT] = { "multiball", "split", "grow", "shrink", "speed" };
+	vector<PowerUpSpawn> schedule;
+	string line;
+	int lineNumber = 0;
+	while (getline(file, line)) {
+		lineNumber++;
+		istringstream in(line);
+		string keyword;
+		if (!(in >> keyword) || keyword[0] == '#') {
+			continue; // blank line or comment
+		}
+
+		PowerUpSpawn spawn;
+		string effectName;
+		spawn.repeat = 0.0f;
+		in >> spawn.time >> spawn.x >> spawn.y >> effectName >> spawn.amount >> spawn.duration;
+		if (keyword != "spawn" || !in) {
+			cerr << filename << ":" << lineNumber << ": expected spawn <time> <x> <y> <effect> <amount> <duration> [repeat]" << endl;
+			return false;
+		}
+		in >> spawn.repeat; // optional
+
+		int effect = 0;
+		while (effect < EFFECT_COUNT && effectName != names[effect]) {
+			effect++;
+		}
+		if (effect == EFFECT_COUNT) {
+			cerr << filename << ":" << lineNumber << ": unknown effect " << effectName << endl;
+			return false;
+		}
+		spawn.effect = (PowerUpEffect)effect;
+
+		// written so NaN fails every check
+		bool counted = spawn.effect == EFFECT_MULTIBALL || spawn.effect == EFFECT_SPLIT;
+		string problem = "";
+		if (!(spawn.time >= 0.0f)) {
+			problem = "time must be 0 or more";
+		}
+		else if (!(spawn.x >= 0.0f && spawn.x <= 1.0f && spawn.y >= 0.0f && spawn.y <= 1.0f)) {
+			problem = "x and y must be between 0 and 1";
+		}
+		else if (!(spawn.amount > 0.0f) || (counted && !(spawn.amount >= 1.0f && spawn.amount == floor(spawn.amount)))) {
+			problem = counted ? "amount must be a whole number of balls, 1 or more" : "amount must be more than 0";
+		}
+		else if (!(spawn.duration >= 0.0f)) {
+			problem = "duration must be 0 or more";
+		}
+		else if (!(spawn.repeat == 0.0f || spawn.repeat >= MIN_POWERUP_REPEAT)) {
+			problem = "repeat must be 0 or at least 1 ms";
+		}
+		if (problem != "") {
+			cerr << filename << ":" << lineNumber << ": " << problem << endl;
+			return false;
+		}
+		schedule.push_back(spawn);
+	}
+	this->setSchedule(schedule);
+	return true;
+}
+
+void PowerUpSystem::useDefaults() {
+	// the original two multiball powerups, top and bottom of the center line
+	vector<PowerUpSpawn> schedule;
+	PowerUpSpawn spawn = { 0.0f, 0.5f, 0.8f, EFFECT_MULTIBALL, 1.0f, 0.0f, 0.0f };
+	schedule.push_back(spawn);
+	spawn.y = 0.2f;
+	schedule.push_back(spawn);
+	this->setSchedule(schedule);
+}
+
+void PowerUpSystem::setSchedule(vector<PowerUpSpawn> schedule) {
+	// everything the queue will need is reserved here, before play
+	this->schedule = schedule;
+	this->queue.clear();
+	this->queue.reserve(schedule.size());
+	this->clear();
+}
+
+void PowerUpSystem::startServe() {
+	// powerups left on the board are removed and the schedule starts over, effects keep running
+	while (!this->active.empty()) {
+		this->remove((int)this->active.size() - 1);
+	}
+	this->serveTime = 0.0f;
+	this->queue.clear();
+	for (size_t i = 0; i < this->schedule.size(); i++) {
+		this->queue.push_back(make_pair(this->schedule[i].time, (int)i));
+	}
+	make_heap(this->queue.begin(), this->queue.end(), greater<pair<float, int>>());
+}
+
+void PowerUpSystem::clear() {
+	// new match: no powerups and no effects
+	this->active.clear();
+	this->freeSlots.clear();
+	for (int i = MAX_POWERUPS - 1; i >= 0; i--) {
+		this->freeSlots.push_back(i);
+	}
+	this->effectCount = 0;
+	this->expiredCount = 0;
+	this->startServe();
+}
+
+void PowerUpSystem::update(float dt) {
+	this->serveTime += dt;
+
+	// spawn everything that is due, the heap keeps this O(1) when nothing is
+	while (!this->queue.empty() && this->queue.front().first <= this->serveTime) {
+		pop_heap(this->queue.begin(), this->queue.end(), greater<pair<float, int>>());
+		pair<float, int> next = this->queue.back();
+		this->queue.pop_back();
+
+		const PowerUpSpawn& spawn = this->schedule[next.second];
+		if (!this->freeSlots.empty()) { // skipped when the pool is full
+			int slot = this->freeSlots.back();
+			this->freeSlots.pop_back();
+			this->active.push_back(slot);
+			this->pool[slot].setup(Vector2f(spawn.x * WINDOW_WIDTH, spawn.y * WINDOW_HEIGHT), spawn.effect, spawn.amount, spawn.duration);
+		}
+		if (spawn.repeat > 0.0f) {
+			this->queue.push_back(make_pair(next.first + spawn.repeat, next.second));
+			push_heap(this->queue.begin(), this->queue.end(), greater<pair<float, int>>());
+		}
+	}
+
+	// count down running effects, expired ones are handed to the game to undo
+	this->expiredCount = 0;
+	int i = 0;
+	while (i < this->effectCount) {
+		this->effects[i].remaining -= dt;
+		if (this->effects[i].remaining <= 0.0f) {
+			this->expired[this->expiredCount++] = this->effects[i];
+			this->effects[i] = this->effects[--this->effectCount];
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+int PowerUpSystem::getCount() {
+	return (int)this->active.size();
+}
+
+PowerUp* PowerUpSystem::get(int i) {
+	return &this->pool[this->active[i]];
+}
+
+void PowerUpSystem::remove(int i) {
+	// swap with the last one, draw order of powerups does not matter
+	this->freeSlots.push_back(this->active[i]);
+	this->active[i] = this->active.back();
+	this->active.pop_back();
+}
+
+bool PowerUpSystem::addEffect(PowerUpEffect effect, float amount, float duration, int target) {
+	if (this->effectCount >= MAX_EFFECTS) {
+		return false; // caller should not apply it
+	}
+	ActiveEffect* e = &this->effects[this->effectCount++];
+	e->effect = effect;
+	e->amount = amount;
+	e->remaining = duration;
+	e->target = target;
+	return true;
+}
+
+int PowerUpSystem::getEffectCount() {
+	return this->effectCount;
+}
+
+int PowerUpSystem::getExpiredCount() {
+	return this->expiredCount;
+}
+
+ActiveEffect* PowerUpSystem::getExpired(int i) {
+	return &this->expired[i];
+}
+
+/*
+Planner world for SFML Pong
+A plain copy of the board that the planner AI can simulate on other threads while the real game keeps running
+*/
+const int PLANNER_MAX_BALLS = 8; // the oldest balls, the rest are ignored when planning
+
+struct PlannerWorld {
+	int ballCount;
+	float ballX[PLANNER_MAX_BALLS];
+	float ballY[PLANNER_MAX_BALLS];
+	float ballVX[PLANNER_MAX_BALLS];
+	float ballVY[PLANNER_MAX_BALLS];
+	float ballRadius[PLANNER_MAX_BALLS];
+	float paddleX[2]; // left edge of the left (0) and right (1) paddles
+	float paddleY[2]; // top
+	float paddleHeight[2];
+	float paddleWidth;
+	float paddleSpeed;
+	float timeScale;
+};
+
+// paddle starting positions, also used when the board is reset
+const Vector2f PADDLE_LEFT_START = Vector2f(15.0f, WINDOW_HEIGHT / 2.0f - 35.0f);
+const Vector2f PADDLE_RIGHT_START = Vector2f(WINDOW_WIDTH - 15.0f, WINDOW_HEIGHT / 2.0f - 35.0f);
+
+/*
+Game class for SFML Pong
+Holds everything on the board for one match (paddles, balls, powerups, score) and runs one tick of play at a time.
+*/
+class Game {
+public:
+	Game(const Font& scoreFont, const Texture* background, Synth* synth);
+	void newMatch();
+	void resetBoard();
+	int update(float dt);
+	template <class Left, class Right> int step(float dt, Left& left, Right& right);
+	void draw(Canvas* canvas);
+	void drawBoard(Canvas* canvas);
+	void handleEvent(Event& event);
+	void resetControllers();
+	void setControllers(PaddleController* left, PaddleController* right);
+	void setTelemetry(TelemetryLogger* telemetry);
+	void setRecording(Replay* recording, string filename);
+	void setPlayback(Replay* playback);
+	void setCapture(FrameCapture* capture);
+	bool loadPowerUps(string filename);
+	void getPlannerWorld(PlannerWorld* world);
+private:
+	void logEvent(TelemetryEvent type, int side, Ball* ball, float offset);
+	int countActiveBalls();
+	void serve();
+	void collectPowerUp(PowerUp* powerUp, Ball* ball);
+	void spawnBalls(Ball* ball, int count, float spread, bool mirror, float radius);
+	void applyEffect(ActiveEffect* effect, bool undo);
+	Paddle* getPaddle(int side);
+	void playSound(const SynthEvent& event);
+	float getBallSpeed(Ball* ball);
+	Scoreboard scoreboard;
+	BallPool balls;
+	Paddle paddleRight;
+	Paddle paddleLeft;
+	PowerUpSystem powerUps;
+	float ballTimeScale; // from speed powerups
+	Sprite background;
+	RectangleShape midLine;
+	Synth* synth;
+
+	// match telemetry, null when disabled
+	TelemetryLogger* telemetry;
+	uint32_t matchId;
+	uint32_t tick;
+	int rally;
+
+	// paddle controllers, set before the first update
+	PaddleController* leftController;
+	PaddleController* rightController;
+
+	// replay being recorded or played back, null when not in use
+	Replay* recording;
+	string recordingFile;
+	Replay* playback;
+
+	// frame capture that also records sound effects, null when not capturing
+	FrameCapture* capture;
+};
+
+Game::Game(const Font& scoreFont, const Texture* background, Synth* synth) :
+	scoreboard(Vector2f(WINDOW_WIDTH / 2, 20.0f), scoreFont),
+	balls(MAX_BALLS), // main ball and extra balls created by powerups
+	paddleRight(PADDLE_RIGHT_START), // set up left and right paddles, start in middle
+	paddleLeft(PADDLE_LEFT_START) {
+	this->ballTimeScale = 1.0f;
+	this->serve();
+
+	// null background is allowed (headless, nothing to draw it into)
+	if (background != nullptr) {
+		this->background = Sprite(*background);
+	}
+	this->background.setPosition(0.0f, 0.0f);
+
+	this->midLine = RectangleShape(Vector2f(5.0f, WINDOW_HEIGHT));
+	this->midLine.setPosition(Vector2f(WINDOW_WIDTH / 2 - 2.5, 0));
+	this->midLine.setFillColor(Color(255, 255, 255, 255));
+
+	// null synth is allowed (no audio)
+	this->synth = synth;
+
+	this->telemetry = nullptr;
+	this->matchId = 0;
+	this->tick = 0;
+	this->rally = 0;
+
+	this->leftController = nullptr;
+	this->rightController = nullptr;
+	this->recording = nullptr;
+	this->playback = nullptr;
+	this->capture = nullptr;
+}
+
+void Game::newMatch() {
+	this->matchId++;
+	this->tick = 0;
+	this->rally = 0;
+
+	// seed the serves so recorded matches play back the same way
+	if (this->playback != nullptr) {
+		srand(this->playback->getSeed());
+	}
+	else if (this->recording != nullptr) {
+		unsigned seed = (unsigned)time(nullptr);
+		srand(seed);
+		this->recording->begin(seed);
+	}
+
+	this->scoreboard.reset();
+	this->resetBoard();
+	this->resetControllers();
+}
+
+void Game::resetBoard() {
+	// extra balls, powerups and running effects put away, main ball back to center
+	this->balls.clear();
+	this->powerUps.clear();
+	this->ballTimeScale = 1.0f;
+	this->paddleRight.setHeightScale(1.0f);
+	this->paddleLeft.setHeightScale(1.0f);
+	this->serve();
+
+	//return paddles to middle
+	this->paddleRight.setPosition(PADDLE_RIGHT_START);
+	this->paddleLeft.setPosition(PADDLE_LEFT_START);
+}
+
+void Game::serve() {
+	// move main ball to center and start it, powerup schedule starts over
+	Ball* ball = this->balls.spawn();
+	ball->setPosition(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f));
+	ball->randomizeStartVelocity();
+	this->powerUps.startServe();
+	this->rally = 0;
+}
+
+bool Game::loadPowerUps(string filename) {
+	if (!this->powerUps.loadConfig(filename)) {
+		this->powerUps.useDefaults();
+		return false;
+	}
+	return true;
+}
+
+void Game::getPlannerWorld(PlannerWorld* world) {
+	world->ballCount = min(this->balls.getCount(), PLANNER_MAX_BALLS);
+	for (int i = 0; i < world->ballCount; i++) {
+		Ball* ball = this->balls.get(i);
+		world->ballX[i] = ball->getPosition().x;
+		world->ballY[i] = ball->getPosition().y;
+		world->ballVX[i] = ball->getVelocity().x;
+		world->ballVY[i] = ball->getVelocity().y;
+		world->ballRadius[i] = ball->getRadius();
+	}
+	Paddle* paddles[2] = { &this->paddleLeft, &this->paddleRight };
+	for (int p = 0; p < 2; p++) {
+		world->paddleX[p] = paddles[p]->getPosition().x;
+		world->paddleY[p] = paddles[p]->getPosition().y;
+		world->paddleHeight[p] = paddles[p]->getSize().y;
+	}
+	world->paddleWidth = this->paddleLeft.getSize().x;
+	world->paddleSpeed = this->paddleLeft.getSpeed();
+	world->timeScale = this->ballTimeScale;
+}
+
+Paddle* Game::getPaddle(int side) {
+	return side < 0 ? &this->paddleLeft : &this->paddleRight;
+}
+
+void Game::spawnBalls(Ball* ball, int count, float spread, bool mirror, float radius) {
+	// new balls start on the given ball, fanned out by spread radians each
+	Vector2f v = ball->getVelocity();
+	if (mirror) {
+		v.y *= -1.0f;
+	}
+	for (int k = 0; k < count; k++) {
+		Ball* extra = this->balls.spawn();
+		if (extra == nullptr) {
+			return; // pool used up
+		}
+		float theta = spread * ((k + 1) / 2) * (k % 2 == 0 ? 1.0f : -1.0f); // 0, -1, 1, -2, 2...
+		extra->setPosition(ball->getPosition());
+		extra->setVelocity(Vector2f(v.x * cos(theta) - v.y * sin(theta), v.x * sin(theta) + v.y * cos(theta)));
+		extra->setRadius(radius);
+		extra->setLastHit(ball->getLastHit());
+	}
+}
+
+void Game::collectPowerUp(PowerUp* powerUp, Ball* ball) {
+	// grow rewards the paddle that last hit the ball, shrink punishes the other one
+	int hitter = ball->getLastHit();
+	if (hitter == 0) {
+		hitter = ball->getVelocity().x > 0 ? -1 : 1; // not hit yet, credit whoever it is heading away from
+	}
+
+	ActiveEffect effect;
+	effect.effect = powerUp->getEffect();
+	effect.amount = powerUp->getAmount();
+	effect.remaining = powerUp->getDuration();
+	effect.target = hitter;
+	if (effect.effect == EFFECT_SHRINK) {
+		effect.target = -hitter;
+	}
+
+	if (effect.effect == EFFECT_MULTIBALL) {
+		// copies of the ball with y flipped
+		this->spawnBalls(ball, (int)effect.amount, 15.0f * (float)PI / 180.0f, true, ball->getRadius());
+	}
+	else if (effect.effect == EFFECT_SPLIT) {
+		// the ball becomes a fan of smaller balls
+		float radius = max(2.0f, ball->getRadius() / 2.0f);
+		this->spawnBalls(ball, (int)effect.amount - 1, 20.0f * (float)PI / 180.0f, false, radius);
+		ball->setRadius(radius);
+	}
+	else if (this->powerUps.addEffect(effect.effect, effect.amount, effect.remaining, effect.target)) {
+		this->applyEffect(&effect, false); // timed, undone when it runs out
+	}
+}
+
+void Game::applyEffect(ActiveEffect* effect, bool undo) {
+	float factor = undo ? 1.0f / effect->amount : effect->amount;
+	if (effect->effect == EFFECT_GROW || effect->effect == EFFECT_SHRINK) {
+		Paddle* paddle = this->getPaddle(effect->target);
+		paddle->setHeightScale(paddle->getHeightScale() * factor);
+	}
+	else if (effect->effect == EFFECT_SPEED) {
+		this->ballTimeScale *= factor;
+	}
+}
+
+void Game::handleEvent(Event& event) {
+	this->leftController->handleEvent(event);
+	this->rightController->handleEvent(event);
+}
+
+void Game::resetControllers() {
+	if (this->leftController != nullptr) {
+		this->leftController->reset();
+	}
+	if (this->rightController != nullptr) {
+		this->rightController->reset();
+	}
+}
+
+void Game::setControllers(PaddleController* left, PaddleController* right) {
+	this->leftController = left;
+	this->rightController = right;
+}
+
+void Game::setRecording(Replay* recording, string filename) {
+	this->recording = recording;
+	this->recordingFile = filename;
+}
+
+void Game::setPlayback(Replay* playback) {
+	this->playback = playback;
+}
+
+void Game::setCapture(FrameCapture* capture) {
+	this->capture = capture;
+}
+
+void Game::playSound(const SynthEvent& event) {
+	if (this->synth != nullptr) {
+		this->synth->trigger(event);
+	}
+	if (this->capture != nullptr) {
+		this->capture->addSound(event);
+	}
+}
+
+// speed the ball is actually moving at, with any speed powerup
+float Game::getBallSpeed(Ball* ball) {
+	Vector2f v = ball->getVelocity();
+	return sqrt(v.x * v.x + v.y * v.y) * this->ballTimeScale;
+}
+
+void Game::setTelemetry(TelemetryLogger* telemetry) {
+	this->telemetry = telemetry;
+}
+
+int Game::countActiveBalls() {
+	return this->balls.getCount();
+}
+
+void Game::logEvent(TelemetryEvent type, int side, Ball* ball, float offset) {
+	TelemetryRecord record;
+	record.match = this->matchId;
+	record.tick = this->tick;
+	record.type = (uint16_t)type;
+	record.side = (int16_t)side;
+	record.rally = (uint16_t)min(this->rally, 65535);
+	record.balls = (uint16_t)this->countActiveBalls();
+	record.x = ball->getPosition().x;
+	record.y = ball->getPosition().y;
+	record.speed = sqrt(ball->getVelocity().x * ball->getVelocity().x + ball->getVelocity().y * ball->getVelocity().y);
+	record.offset = offset;
+	this->telemetry->record(record);
+}
+
+// runs one tick with the controllers set by setControllers (virtual dispatch)
+int Game::update(float dt) {
+	return this->step<PaddleController, PaddleController>(dt, *this->leftController, *this->rightController);
+}
+
+// runs one tick, returns -1 if the left player won, 1 if the right player won, 0 otherwise
+// with concrete controller types the per-tick controller calls inline (see runBatch)
+template <class Left, class Right>
+int Game::step(float dt, Left& left, Right& right) {
+	this->tick++;
+	if (this->playback != nullptr) {
+		dt = this->playback->getDt(this->tick - 1); // same timesteps as the recording
+	}
+
+	// update movements of the paddles
+	float leftMove = 0.0f;
+	float rightMove = 0.0f;
+	if (this->balls.getCount() > 0) { // track oldest ball in play
+		Vector2f tracked = this->balls.get(0)->getPosition();
+		rightMove = this->paddleRight.update(dt, right, tracked, this->tick);
+		leftMove = this->paddleLeft.update(dt, left, tracked, this->tick);
+	}
+	if (this->recording != nullptr) {
+		this->recording->addTick(dt, leftMove, rightMove);
+	}
+
+	// spawn scheduled powerups and undo effects that ran out
+	this->powerUps.update(dt);
+	for (int i = 0; i < this->powerUps.getExpiredCount(); i++) {
+		this->applyEffect(this->powerUps.getExpired(i), true);
+	}
+
+	//update ball behavior for each ball in the pool
+	int i = 0;
+	while (i < this->balls.getCount()) {
+		Ball* ball = this->balls.get(i);
+		if (ball->update(dt * this->ballTimeScale)) { // upate ball position (will set offscreen if offscreen)
+			this->playSound(synthEvent(SYNTH_WALL, this->getBallSpeed(ball), 0.0f, ball->getPosition().x));
+		}
+
+		// check paddle collisions
+		if (collisionRectangle(ball, &this->paddleRight)) {
+			ball->bounce(this->paddleRight);
+			ball->setPosition(Vector2f(this->paddleRight.getPosition().x - ball->getRadius() - 1.0f, ball->getPosition().y));
+			ball->setLastHit(1);
+			this->rally++;
+			float halfHeight = this->paddleRight.getSize().y / 2.0f;
+			float offset = (ball->getPosition().y - this->paddleRight.getPosition().y - halfHeight) / halfHeight;
+			if (this->telemetry != nullptr) {
+				this->logEvent(TELEMETRY_BOUNCE, 1, ball, offset);
+			}
+			this->playSound(synthEvent(SYNTH_IMPACT, this->getBallSpeed(ball), offset, ball->getPosition().x));
+		}
+		else if (collisionRectangle(ball, &this->paddleLeft)) {
+			ball->bounce(this->paddleLeft);
+			ball->setPosition(Vector2f(this->paddleLeft.getPosition().x + this->paddleLeft.getSize().x +
+				ball->getRadius() + 1.0f, ball->getPosition().y));
+			ball->setLastHit(-1);
+			this->rally++;
+			float halfHeight = this->paddleLeft.getSize().y / 2.0f;
+			float offset = (ball->getPosition().y - this->paddleLeft.getPosition().y - halfHeight) / halfHeight;
+			if (this->telemetry != nullptr) {
+				this->logEvent(TELEMETRY_BOUNCE, -1, ball, offset);
+			}
+			this->playSound(synthEvent(SYNTH_IMPACT, this->getBallSpeed(ball), offset, ball->getPosition().x));
+		}
+
+		// check if ball hit a powerup, backwards since collecting swaps the last one in
+		for (int j = this->powerUps.getCount() - 1; j >= 0; j--) {
+			PowerUp* powerUp = this->powerUps.get(j);
+			if (collisionCircle(ball->getPosition(), ball->getRadius(), powerUp->getPosition(), powerUp->getRadius())) {
+				this->collectPowerUp(powerUp, ball);
+				if (this->telemetry != nullptr) {
+					this->logEvent(TELEMETRY_POWERUP, powerUp->getEffect(), ball, 0.0f); // side is the effect
+				}
+				this->playSound(synthEvent(SYNTH_POWERUP, this->getBallSpeed(ball), 0.0f, powerUp->getPosition().x));
+				this->powerUps.remove(j);
+			}
+		}
+
+		// keep track of balls leaving the screen, scores
+		if (ball->isOffScreen() != 0) {
+			if (ball->isOffScreen() < 0) {
+				// off the left side
+				this->scoreboard.update(1, 1);
+			}
+			else { // off right side
+				this->scoreboard.update(0, 1);
+			}
+			if (this->telemetry != nullptr) {
+				this->logEvent(TELEMETRY_SCORE, -ball->isOffScreen(), ball, 0.0f); // side is the scorer
+			}
+			this->balls.release(i); // next ball moves into slot i
+		}
+		else {
+			i++;
+		}
+	}
+
+	// if no balls on screen, serve again
+	if (this->balls.getCount() == 0) {
+		this->serve();
+	}
+
+	// check if anyone won
+	int winner = 0;
+	if (this->scoreboard.getScore(0) >= 5) {
+		winner = -1;
+	}
+	else if (this->scoreboard.getScore(1) >= 5) {
+		winner = 1;
+	}
+	if (winner != 0 && this->recording != nullptr) {
+		if (!this->recording->save(this->recordingFile)) {
+			cerr << "Could not save replay " << this->recordingFile << endl;
+		}
+	}
+	if (winner != 0 && this->telemetry != nullptr) {
+		// x and y hold the final left and right scores for match end records
+		TelemetryRecord record;
+		memset(&record, 0, sizeof(record));
+		record.match = this->matchId;
+		record.tick = this->tick;
+		record.type = TELEMETRY_MATCH_END;
+		record.side = (int16_t)winner;
+		record.x = (float)this->scoreboard.getScore(0);
+		record.y = (float)this->scoreboard.getScore(1);
+		this->telemetry->record(record);
+	}
+	return winner;
+}
+
+void Game::drawBoard(Canvas* canvas) {
+	// draw static board objects
+	if (this->background.getTexture() != nullptr) {
+		canvas->draw(this->background);
+	}
+	canvas->draw(this->midLine);
+
+	this->scoreboard.draw(canvas);
+	this->paddleRight.draw(canvas);
+	this->paddleLeft.draw(canvas);
+}
+
+void Game::draw(Canvas* canvas) {
+	this->drawBoard(canvas);
+
+	// draw all balls in play
+	for (int i = 0; i < this->balls.getCount(); i++) {
+		this->balls.get(i)->draw(canvas);
+	}
+
+	// draw all uncollected powerups
+	for (int i = 0; i < this->powerUps.getCount(); i++) {
+		this->powerUps.get(i)->draw(canvas);
+	}
+}
+
+/*
+Planner AI for SFML Pong
+Expert tier. At each decision point the board is copied and every candidate aim (where on the paddle to meet the
+ball, which sets the return angle) is played out in many short headless rollouts against a noisy model of the
+reactive AI. Rollouts run on a thread pool, each thread with its own arena (world copy, random state, tallies),
+until a fixed wall clock budget runs out, then the aim with the best average outcome is kept until the next decision.
+The calling thread runs rollouts too, so with one core there are no workers and it plans alone within the same budget.
+*/
+const int PLANNER_CANDIDATES = 7;
+const float PLANNER_AIMS[PLANNER_CANDIDATES] = { 0.0f, -0.3f, 0.3f, -0.6f, 0.6f, -0.85f, 0.85f }; // center first, wins ties
+const int PLANNER_MAX_THREADS = 8; // including the calling thread
+const float PLANNER_BUDGET_MS = 2.0f;
+const float PLANNER_STEP_MS = 8.0f; // rollout timestep, small enough that fast balls can't skip a paddle
+const int PLANNER_HORIZON_STEPS = 400; // 3.2 s, about one exchange
+const uint32_t PLANNER_REPLAN_TICKS = 6;
+
+struct alignas(64) PlannerArena { // cache line aligned so threads don't share tallies
+	PlannerWorld world;
+	uint32_t seed;
+	float score[PLANNER_CANDIDATES];
+	int rollouts[PLANNER_CANDIDATES];
+	uint32_t finishedRound;
+};
+
+inline float plannerRandom(uint32_t& state) {
+	// xorshift, 0 to 1
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+// where a ball will cross x, folded off the top and bottom walls, or -1 if it is heading away
+inline float plannerIntercept(const PlannerWorld& world, int i, float x) {
+	float vx = world.ballVX[i];
+	float t = (x - world.ballX[i]) / vx;
+	if (vx == 0.0f || t < 0.0f) {
+		return -1.0f;
+	}
+	float r = world.ballRadius[i];
+	float span = WINDOW_HEIGHT - 2.0f * r;
+	float p = fmod(world.ballY[i] + world.ballVY[i] * t - r, 2.0f * span);
+	if (p < 0.0f) {
+		p += 2.0f * span;
+	}
+	if (p > span) {
+		p = 2.0f * span - p;
+	}
+	return p + r;
+}
+
+// planner's own paddle: meet the first ball to arrive at aim (-1 top end, 1 bottom end), recenter otherwise
+inline float plannerMove(const PlannerWorld& world, int side, float aim) {
+	int p = side < 0 ? 0 : 1;
+	float face = side < 0 ? world.paddleX[0] + world.paddleWidth : world.paddleX[1];
+	float target = WINDOW_HEIGHT / 2.0f;
+	float soonest = 0.0f;
+	for (int i = 0; i < world.ballCount; i++) {
+		float y = plannerIntercept(world, i, face);
+		float t = (face - world.ballX[i]) / world.ballVX[i];
+		if (y >= 0.0f && (soonest == 0.0f || t < soonest)) {
+			soonest = t;
+			target = y - aim * world.paddleHeight[p] / 2.0f;
+		}
+	}
+	float center = world.paddleY[p] + world.paddleHeight[p] / 2.0f;
+	return max(-1.0f, min(1.0f, (target - center) / (world.paddleSpeed * PLANNER_STEP_MS)));
+}
+
+// plays the world forward, returns points won minus points lost plus a little for leaving the opponent stretched
+float plannerRollout(PlannerWorld& world, int side, float aim, uint32_t& seed) {
+	int self = side < 0 ? 0 : 1;
+	int other = 1 - self;
+
+	// the opponent tracks the oldest ball like AiController, with a random reach, aim error and speed
+	float reach = WINDOW_WIDTH / 2.0f * (0.6f + 0.6f * plannerRandom(seed));
+	float error = (plannerRandom(seed) - 0.5f) * 0.6f * world.paddleHeight[other];
+	float otherSpeed = world.paddleSpeed * (0.85f + 0.15f * plannerRandom(seed));
+
+	float result = 0.0f;
+	bool hit = false;
+	float dt = PLANNER_STEP_MS;
+	for (int step = 0; step < PLANNER_HORIZON_STEPS && world.ballCount > 0; step++) {
+		// own paddle takes the candidate aim on the first return, then plays safe from the middle
+		float move = plannerMove(world, side, hit ? 0.0f : aim);
+		world.paddleY[self] = max(0.0f, min(WINDOW_HEIGHT - world.paddleHeight[self], world.paddleY[self] + move * world.paddleSpeed * dt));
+
+		float top = world.paddleY[other];
+		float target = world.ballY[0] + error;
+		float distance = abs(world.paddleX[other] - world.ballX[0]);
+		float otherMove = 0.0f;
+		if (distance < reach) {
+			otherMove = target > top + world.paddleHeight[other] ? 1.0f : (target < top ? -1.0f : 0.0f);
+		}
+		world.paddleY[other] = max(0.0f, min(WINDOW_HEIGHT - world.paddleHeight[other], top + otherMove * otherSpeed * dt));
+
+		int i = 0;
+		while (i < world.ballCount) {
+			float r = world.ballRadius[i];
+			world.ballX[i] += world.ballVX[i] * dt * world.timeScale;
+			world.ballY[i] += world.ballVY[i] * dt * world.timeScale;
+			if (world.ballY[i] + r > WINDOW_HEIGHT) {
+				world.ballY[i] = WINDOW_HEIGHT - r;
+				world.ballVY[i] *= -1.0f;
+			}
+			else if (world.ballY[i] - r < 0.0f) {
+				world.ballY[i] = r;
+				world.ballVY[i] *= -1.0f;
+			}
+
+			// same paddle test and bounce as the game
+			for (int p = 0; p < 2; p++) {
+				float px = world.paddleX[p];
+				float py = world.paddleY[p];
+				float ph = world.paddleHeight[p];
+				float dx = world.ballX[i] - max(px, min(px + world.paddleWidth, world.ballX[i]));
+				float dy = world.ballY[i] - max(py, min(py + ph, world.ballY[i]));
+				if (dx * dx + dy * dy <= r * r) {
+					float ratio = abs(py + ph / 2.0f - world.ballY[i]) / (ph / 2.0f);
+					Vector2f normal = Vector2f(world.ballVX[i] > 0.0f ? -1.0f : 1.0f, 0.0f);
+					Vector2f v = bounceVelocity(Vector2f(world.ballVX[i], world.ballVY[i]), ratio, normal, Vector2f(0.0f, 1.0f));
+					world.ballVX[i] = v.x;
+					world.ballVY[i] = v.y;
+					world.ballX[i] = p == 0 ? px + world.paddleWidth + r + 1.0f : px - r - 1.0f;
+					hit = hit || p == self;
+					break;
+				}
+			}
+
+			// off the left or right edge
+			int out = world.ballX[i] + r > WINDOW_WIDTH ? 1 : (world.ballX[i] - r < 0.0f ? 0 : -1);
+			if (out >= 0) {
+				result += out == self ? -1.0f : 1.0f;
+				world.ballCount--;
+				world.ballX[i] = world.ballX[world.ballCount];
+				world.ballY[i] = world.ballY[world.ballCount];
+				world.ballVX[i] = world.ballVX[world.ballCount];
+				world.ballVY[i] = world.ballVY[world.ballCount];
+				world.ballRadius[i] = world.ballRadius[world.ballCount];
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	// still in play: balls heading at the opponent are worth more the further they have to reach
+	float otherFace = other == 0 ? world.paddleX[0] + world.paddleWidth : world.paddleX[1];
+	float otherCenter = world.paddleY[other] + world.paddleHeight[other] / 2.0f;
+	for (int i = 0; i < world.ballCount; i++) {
+		float y = plannerIntercept(world, i, otherFace);
+		if (y >= 0.0f) {
+			result += 0.25f * min(1.0f, abs(y - otherCenter) / WINDOW_HEIGHT * 2.0f);
+		}
+	}
+	return result;
+}
+
+class PlannerController final : public ControllerBase<PlannerController> {
+public:
+	PlannerController(Game* game, int side, float budgetMs);
+	~PlannerController();
+	float decideImpl(const ControllerView& view);
+	void reset();
+	int getThreads();
+	uint64_t getDecisions();
+	uint64_t getRollouts();
+	float getMaxDecisionMs();
+	float getTotalDecisionMs();
+private:
+	void plan();
+	void runRollouts(PlannerArena* arena, uint32_t round, chrono::steady_clock::time_point deadline);
+	void work(int index);
+	int countApproaching();
+	Game* game;
+	int side;
+	float budgetMs;
+	float aim; // chosen candidate, followed between decisions
+	uint32_t lastPlanTick;
+	int lastApproaching;
+	PlannerWorld world;
+
+	// pool, arena 0 belongs to the calling thread
+	int threads;
+	vector<uint8_t> arenaStorage; // the heap only promises 16 byte alignment, the arenas start on a cache line inside this
+	PlannerArena* arenas;
+	vector<thread> workers;
+	mutex lock;
+	condition_variable wake;
+	condition_variable done;
+	uint32_t round;
+	int finished; // workers done with the current round
+	bool stopping;
+	PlannerWorld roundWorld;
+	chrono::steady_clock::time_point deadline;
+
+	// stats
+	uint64_t decisions;
+	uint64_t rollouts;
+	float maxDecisionMs;
+	float totalDecisionMs;
+};
+
+PlannerController::PlannerController(Game* game, int side, float budgetMs) {
+	this->game = game;
+	this->side = side;
+	this->budgetMs = budgetMs;
+	this->aim = 0.0f;
+	this->lastPlanTick = 0;
+	this->lastApproaching = 0;
+	this->round = 0;
+	this->finished = 0;
+	this->stopping = false;
+	this->decisions = 0;
+	this->rollouts = 0;
+	this->maxDecisionMs = 0.0f;
+	this->totalDecisionMs = 0.0f;
+	memset(&this->world, 0, sizeof(this->world));
+
+	// leave a core for the render thread's own work, planning alone on single core machines
+	int cores = (int)thread::hardware_concurrency();
+	this->threads = max(1, min(PLANNER_MAX_THREADS, cores - 1));
+	this->arenaStorage.resize(sizeof(PlannerArena) * PLANNER_MAX_THREADS + alignof(PlannerArena) - 1);
+	this->arenas = (PlannerArena*)(((uintptr_t)this->arenaStorage.data() + alignof(PlannerArena) - 1) & ~(uintptr_t)(alignof(PlannerArena) - 1));
+	for (int i = 0; i < PLANNER_MAX_THREADS; i++) {
+		new (&this->arenas[i]) PlannerArena();
+		this->arenas[i].seed = 2463534242u + 7919u * i;
+		this->arenas[i].finishedRound = 0;
+	}
+	for (int i = 1; i < this->threads; i++) {
+		this->workers.push_back(thread(&PlannerController::work, this, i));
+	}
+}
+
+PlannerController::~PlannerController() {
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (size_t i = 0; i < this->workers.size(); i++) {
+		this->workers[i].join();
+	}
+}
+
+void PlannerController::reset() {
+	this->aim = 0.0f;
+	this->lastPlanTick = 0;
+	this->lastApproaching = 0;
+}
+
+int PlannerController::countApproaching() {
+	int count = 0;
+	for (int i = 0; i < this->world.ballCount; i++) {
+		count += this->world.ballVX[i] * this->side > 0.0f;
+	}
+	return count;
+}
+
+inline float PlannerController::decideImpl(const ControllerView& view) {
+	this->game->getPlannerWorld(&this->world);
+
+	// decide again on a timer, or straight away when a ball turns towards us
+	int approaching = this->countApproaching();
+	if (view.tick < this->lastPlanTick || view.tick - this->lastPlanTick >= PLANNER_REPLAN_TICKS || approaching > this->lastApproaching) {
+		this->plan();
+		this->lastPlanTick = view.tick;
+	}
+	this->lastApproaching = approaching;
+	return plannerMove(this->world, this->side, this->aim);
+}
+
+void PlannerController::plan() {
+	auto start = chrono::steady_clock::now();
+	auto deadline = start + chrono::microseconds((int64_t)(this->budgetMs * 1000.0f));
+	uint32_t current;
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->roundWorld = this->world;
+		this->deadline = deadline;
+		this->finished = 0;
+		current = ++this->round;
+	}
+	this->wake.notify_all();
+
+	this->arenas[0].world = this->world;
+	this->runRollouts(&this->arenas[0], current, deadline);
+
+	// workers stop at the deadline too, give them a sliver to finish their last rollout and skip any that don't
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->done.wait_until(guard, deadline + chrono::microseconds(200), [this]() { return this->finished >= this->threads - 1; });
+	}
+
+	float score[PLANNER_CANDIDATES] = { 0 };
+	int count[PLANNER_CANDIDATES] = { 0 };
+	for (int t = 0; t < this->threads; t++) {
+		PlannerArena* arena = &this->arenas[t];
+		unique_lock<mutex> guard(this->lock); // pairs with the worker publishing its tallies
+		if (arena->finishedRound != current) {
+			continue;
+		}
+		for (int c = 0; c < PLANNER_CANDIDATES; c++) {
+			score[c] += arena->score[c];
+			count[c] += arena->rollouts[c];
+		}
+	}
+	int best = -1;
+	float bestMean = 0.0f;
+	for (int c = 0; c < PLANNER_CANDIDATES; c++) {
+		this->rollouts += count[c];
+		if (count[c] > 0 && (best < 0 || score[c] / count[c] > bestMean)) {
+			best = c;
+			bestMean = score[c] / count[c];
+		}
+	}
+	if (best >= 0) {
+		this->aim = PLANNER_AIMS[best];
+	}
+
+	float ms = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+	this->decisions++;
+	this->totalDecisionMs += ms;
+	this->maxDecisionMs = max(this->maxDecisionMs, ms);
+}
+
+void PlannerController::runRollouts(PlannerArena* arena, uint32_t round, chrono::steady_clock::time_point deadline) {
+	PlannerWorld start = arena->world;
+	for (int c = 0; c < PLANNER_CANDIDATES; c++) {
+		arena->score[c] = 0.0f;
+		arena->rollouts[c] = 0;
+	}
+
+	// round robin over candidates so each gets a fair share of whatever time there is
+	int c = 0;
+	while (chrono::steady_clock::now() < deadline) {
+		arena->world = start;
+		arena->score[c] += plannerRollout(arena->world, this->side, PLANNER_AIMS[c], arena->seed);
+		arena->rollouts[c]++;
+		c = (c + 1) % PLANNER_CANDIDATES;
+	}
+	arena->finishedRound = round;
+}
+
+void PlannerController::work(int index) {
+	PlannerArena* arena = &this->arenas[index];
+	uint32_t seen = 0;
+	while (true) {
+		uint32_t current;
+		chrono::steady_clock::time_point deadline;
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->wake.wait(guard, [&]() { return this->stopping || this->round != seen; });
+			if (this->stopping) {
+				return;
+			}
+			current = this->round;
+			seen = current;
+			deadline = this->deadline;
+			arena->world = this->roundWorld; // copied under the lock, the next round may overwrite it
+		}
+
+		PlannerArena scratch = *arena; // tallies stay private until the round is published
+		this->runRollouts(&scratch, current, deadline);
+
+		{
+			unique_lock<mutex> guard(this->lock);
+			*arena = scratch;
+			if (current == this->round) {
+				this->finished++;
+			}
+		}
+		this->done.notify_one();
+	}
+}
+
+int PlannerController::getThreads() {
+	return this->threads;
+}
+
+uint64_t PlannerController::getDecisions() {
+	return this->decisions;
+}
+
+uint64_t PlannerController::getRollouts() {
+	return this->rollouts;
+}
+
+float PlannerController::getMaxDecisionMs() {
+	return this->maxDecisionMs;
+}
+
+float PlannerController::getTotalDecisionMs() {
+	return this->totalDecisionMs;
+}
+
+/*
+Arena class for SFML Pong
+2 to 16 players, each defending one edge of a regular polygon (2 players get a square with walls top and bottom).
+Paddles are oriented boxes sliding along their edge and the balls are circles, kept as arrays of floats so the
+ball-vs-paddle and ball-vs-edge tests run as one branch-free loop over every ball per edge, which compilers vectorize.
+A ball that leaves through an edge scores a point for the last player to hit it.
+*/
+const int MAX_ARENA_PLAYERS = 16;
+const int MAX_ARENA_BALLS = 512;
+const int ARENA_WIN_SCORE = 5;
+const float ARENA_RADIUS = WINDOW_HEIGHT / 2.0f - 10.0f;
+const float ARENA_SERVE_SPEED = 0.3f;
+const float ARENA_MAX_SPEED = 1.5f; // polygons keep balls in play longer than the classic board, so cap the 10% speedups
+
+class Arena {
+public:
+	Arena(const Font& font);
+	void setup(int players, int balls);
+	void setController(int player, PaddleController* controller);
+	void newMatch();
+	int update(float dt);
+	template <class Controller> int step(float dt, Controller** controllers);
+	void handleEvent(Event& event);
+	void resetControllers();
+	void draw(Canvas* canvas);
+	int getPlayers();
+	int getBallCount();
+private:
+	void serveBall(int i);
+	void removeBall(int i);
+	int trackBall(int edge);
+	void collidePaddle(int edge);
+	void collideEdge(int edge);
+	int players;
+	int sides;
+	float edgeLength;
+
+	// per edge, tangent runs along the edge from its start and normal points into the arena
+	Vector2f edgeStart[MAX_ARENA_PLAYERS];
+	Vector2f edgeTangent[MAX_ARENA_PLAYERS];
+	Vector2f edgeNormal[MAX_ARENA_PLAYERS];
+	int edgeOwner[MAX_ARENA_PLAYERS]; // player defending the edge, -1 for walls
+
+	// per player
+	float paddleAlong[MAX_ARENA_PLAYERS]; // paddle center, distance along its edge
+	float paddleHalfLength;
+	float paddleHalfThickness;
+	float paddleInset; // gap between the edge and the paddle's face
+	float paddleSpeed;
+	PaddleController* controllers[MAX_ARENA_PLAYERS];
+
+	// balls, one array per field
+	int ballCount;
+	int ballTarget; // balls kept in play
+	float ballRadius;
+	float ballX[MAX_ARENA_BALLS];
+	float ballY[MAX_ARENA_BALLS];
+	float ballVX[MAX_ARENA_BALLS];
+	float ballVY[MAX_ARENA_BALLS];
+	int ballLastHit[MAX_ARENA_BALLS];
+	int hitMask[MAX_ARENA_BALLS]; // scratch for the batched tests, int rather than bytes so stores can't alias the floats
+	float hitAlong[MAX_ARENA_BALLS];
+
+	uint32_t tick;
+	Scoreboard scoreboard;
+	RectangleShape edgeShape;
+	RectangleShape paddleShape;
+	CircleShape ballShape;
+};
+
+Arena::Arena(const Font& font) : scoreboard(2, font) {
+	for (int i = 0; i < MAX_ARENA_PLAYERS; i++) {
+		this->controllers[i] = nullptr;
+	}
+	this->ballRadius = 5.0f;
+	this->ballShape = CircleShape(this->ballRadius);
+	this->ballShape.setFillColor(Color::White);
+	this->setup(2, 1);
+}
+
+void Arena::setup(int players, int balls) {
+	this->players = max(2, min(MAX_ARENA_PLAYERS, players));
+	this->ballTarget = max(1, min(MAX_ARENA_BALLS, balls));
+	this->sides = this->players == 2 ? 4 : this->players;
+
+	// regular polygon around the window center, edge 0 on the left
+	Vector2f center = Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f);
+	for (int e = 0; e < this->sides; e++) {
+		float a0 = (float)(PI - PI / this->sides + 2.0 * PI * e / this->sides);
+		float a1 = (float)(PI - PI / this->sides + 2.0 * PI * (e + 1) / this->sides);
+		Vector2f p0 = center + Vector2f(cos(a0), sin(a0)) * ARENA_RADIUS;
+		Vector2f p1 = center + Vector2f(cos(a1), sin(a1)) * ARENA_RADIUS;
+		Vector2f d = p1 - p0;
+		this->edgeLength = sqrt(d.x * d.x + d.y * d.y);
+
+		// run every edge downwards (or rightwards) so "down" keys move paddles the way players expect
+		if (d.y < -0.001f || (abs(d.y) <= 0.001f && d.x < 0)) {
+			swap(p0, p1);
+			d = -d;
+		}
+		this->edgeStart[e] = p0;
+		this->edgeTangent[e] = d / this->edgeLength;
+		Vector2f n = Vector2f(-this->edgeTangent[e].y, this->edgeTangent[e].x);
+		Vector2f toCenter = center - p0;
+		if (n.x * toCenter.x + n.y * toCenter.y < 0) {
+			n = -n;
+		}
+		this->edgeNormal[e] = n;
+	}
+	for (int e = 0; e < this->sides; e++) {
+		if (this->players == 2) {
+			this->edgeOwner[e] = e % 2 == 0 ? e / 2 : -1; // left and right edges play, top and bottom are walls
+		}
+		else {
+			this->edgeOwner[e] = e;
+		}
+	}
+
+	// paddles shrink with the edges, same 10 by 70 as the classic game at most
+	this->paddleHalfLength = min(35.0f, this->edgeLength * 0.15f);
+	this->paddleHalfThickness = 5.0f;
+	this->paddleInset = 15.0f;
+	this->paddleSpeed = 0.4f;
+	this->paddleShape = RectangleShape(Vector2f(this->paddleHalfLength * 2.0f, this->paddleHalfThickness * 2.0f));
+	this->paddleShape.setOrigin(this->paddleHalfLength, this->paddleHalfThickness);
+	this->edgeShape = RectangleShape(Vector2f(this->edgeLength, 2.0f));
+	this->edgeShape.setOrigin(0.0f, 1.0f);
+
+	// scores sit inside the arena next to each player's edge
+	this->scoreboard.setPlayers(this->players);
+	for (int e = 0; e < this->sides; e++) {
+		int owner = this->edgeOwner[e];
+		if (owner >= 0) {
+			Vector2f mid = this->edgeStart[e] + this->edgeTangent[e] * (this->edgeLength / 2.0f);
+			this->scoreboard.setPosition(owner, mid + this->edgeNormal[e] * 45.0f - Vector2f(8.0f, 18.0f));
+		}
+	}
+	this->newMatch();
+}
+
+void Arena::setController(int player, PaddleController* controller) {
+	this->controllers[player] = controller;
+}
+
+void Arena::newMatch() {
+	this->tick = 0;
+	this->scoreboard.reset();
+	for (int p = 0; p < this->players; p++) {
+		this->paddleAlong[p] = this->edgeLength / 2.0f;
+	}
+	this->ballCount = 0;
+	while (this->ballCount < this->ballTarget) {
+		this->serveBall(this->ballCount++);
+	}
+	this->resetControllers();
+}
+
+void Arena::serveBall(int i) {
+	// from the center in a random direction
+	float theta = (rand() % 360) * (float)PI / 180.0f;
+	this->ballX[i] = WINDOW_WIDTH / 2.0f;
+	this->ballY[i] = WINDOW_HEIGHT / 2.0f;
+	this->ballVX[i] = cos(theta) * ARENA_SERVE_SPEED;
+	this->ballVY[i] = sin(theta) * ARENA_SERVE_SPEED;
+	this->ballLastHit[i] = -1;
+}
+
+void Arena::removeBall(int i) {
+	// last ball moves into the gap
+	this->ballCount--;
+	this->ballX[i] = this->ballX[this->ballCount];
+	this->ballY[i] = this->ballY[this->ballCount];
+	this->ballVX[i] = this->ballVX[this->ballCount];
+	this->ballVY[i] = this->ballVY[this->ballCount];
+	this->ballLastHit[i] = this->ballLastHit[this->ballCount];
+}
+
+void Arena::handleEvent(Event& event) {
+	for (int p = 0; p < this->players; p++) {
+		if (this->controllers[p] != nullptr) {
+			this->controllers[p]->handleEvent(event);
+		}
+	}
+}
+
+void Arena::resetControllers() {
+	for (int p = 0; p < this->players; p++) {
+		if (this->controllers[p] != nullptr) {
+			this->controllers[p]->reset();
+		}
+	}
+}
+
+int Arena::getPlayers() {
+	return this->players;
+}
+
+int Arena::getBallCount() {
+	return this->ballCount;
+}
+
+int Arena::trackBall(int edge) {
+	// the nearest ball heading for this edge, or the nearest ball if none are
+	Vector2f s = this->edgeStart[edge];
+	Vector2f n = this->edgeNormal[edge];
+	const float* xs = this->ballX;
+	const float* ys = this->ballY;
+	const float* vxs = this->ballVX;
+	const float* vys = this->ballVY;
+	float* keys = this->hitAlong;
+	int count = this->ballCount;
+
+	// distance to the edge, pushed past every incoming ball when going away
+	for (int i = 0; i < count; i++) {
+		float distance = (xs[i] - s.x) * n.x + (ys[i] - s.y) * n.y;
+		float away = (float)(vxs[i] * n.x + vys[i] * n.y >= 0.0f);
+		keys[i] = distance + away * ARENA_RADIUS * 4.0f;
+	}
+
+	int best = count > 0 ? 0 : -1;
+	for (int i = 1; i < count; i++) {
+		best = keys[i] < keys[best] ? i : best;
+	}
+	return best;
+}
+
+void Arena::collidePaddle(int edge) {
+	// circle vs oriented box for every ball at once, the paddle is a box in (along, across) edge coordinates
+	int owner = this->edgeOwner[edge];
+	Vector2f u = this->edgeTangent[edge];
+	Vector2f n = this->edgeNormal[edge];
+	Vector2f c = this->edgeStart[edge] + u * this->paddleAlong[owner] + n * (this->paddleInset - this->paddleHalfThickness);
+	float hu = this->paddleHalfLength;
+	float hn = this->paddleHalfThickness;
+	float rr = this->ballRadius * this->ballRadius;
+	const float* xs = this->ballX;
+	const float* ys = this->ballY;
+	const float* vxs = this->ballVX;
+	const float* vys = this->ballVY;
+	float* alongs = this->hitAlong;
+	int* mask = this->hitMask;
+	int count = this->ballCount;
+	int hits = 0;
+
+	for (int i = 0; i < count; i++) {
+		float dx = xs[i] - c.x;
+		float dy = ys[i] - c.y;
+		float along = dx * u.x + dy * u.y;
+		float across = dx * n.x + dy * n.y;
+		float da = along - min(hu, max(-hu, along));
+		float dn = across - min(hn, max(-hn, across));
+		float outgoing = vxs[i] * n.x + vys[i] * n.y; // negative when heading for the edge
+		int hit = (int)(da * da + dn * dn <= rr) & (int)(outgoing < 0.0f);
+		mask[i] = hit;
+		alongs[i] = along;
+		hits += hit;
+	}
+	if (hits == 0) {
+		return;
+	}
+
+	// hits are rare, bounce them one at a time with the same rule as the classic paddles
+	for (int i = 0; i < this->ballCount; i++) {
+		if (this->hitMask[i]) {
+			Vector2f v = bounceVelocity(Vector2f(this->ballVX[i], this->ballVY[i]), abs(this->hitAlong[i]) / hu, n, u);
+			float speed = sqrt(v.x * v.x + v.y * v.y);
+			if (speed > ARENA_MAX_SPEED) {
+				v = v * (ARENA_MAX_SPEED / speed);
+			}
+			this->ballVX[i] = v.x;
+			this->ballVY[i] = v.y;
+
+			// put the ball back in front of the paddle's face
+			float across = (this->ballX[i] - c.x) * n.x + (this->ballY[i] - c.y) * n.y;
+			float push = hn + this->ballRadius + 1.0f - across;
+			if (push > 0.0f) {
+				this->ballX[i] += n.x * push;
+				this->ballY[i] += n.y * push;
+			}
+			this->ballLastHit[i] = owner;
+		}
+	}
+}
+
+void Arena::collideEdge(int edge) {
+	// balls past the edge line score (player edges) or bounce back (walls)
+	Vector2f s = this->edgeStart[edge];
+	Vector2f n = this->edgeNormal[edge];
+	int owner = this->edgeOwner[edge];
+	float limit = owner >= 0 ? -this->ballRadius : this->ballRadius; // fully out for goals, touching for walls
+	const float* xs = this->ballX;
+	const float* ys = this->ballY;
+	float* acrosses = this->hitAlong;
+	int* mask = this->hitMask;
+	int count = this->ballCount;
+	int hits = 0;
+
+	for (int i = 0; i < count; i++) {
+		float across = (xs[i] - s.x) * n.x + (ys[i] - s.y) * n.y;
+		acrosses[i] = across;
+		int hit = (int)(across < limit);
+		mask[i] = hit;
+		hits += hit;
+	}
+	if (hits == 0) {
+		return;
+	}
+
+	// backwards, since removing a ball moves the last one into its place
+	for (int i = this->ballCount - 1; i >= 0; i--) {
+		if (!this->hitMask[i]) {
+			continue;
+		}
+		if (owner < 0) {
+			// wall: mirror the velocity across the normal and push back inside
+			float vn = this->ballVX[i] * n.x + this->ballVY[i] * n.y;
+			if (vn < 0.0f) {
+				this->ballVX[i] -= 2.0f * vn * n.x;
+				this->ballVY[i] -= 2.0f * vn * n.y;
+			}
+			float push = this->ballRadius - this->hitAlong[i];
+			this->ballX[i] += n.x * push;
+			this->ballY[i] += n.y * push;
+		}
+		else {
+			int scorer = this->ballLastHit[i];
+			if (scorer >= 0 && scorer != owner) {
+				this->scoreboard.update(scorer, 1);
+			}
+			this->removeBall(i);
+		}
+	}
+}
+
+// runs one tick with the controllers set by setController, returns the winning player + 1, or 0
+int Arena::update(float dt) {
+	return this->step<PaddleController>(dt, this->controllers);
+}
+
+// Controller is PaddleController for virtual dispatch, or a concrete controller to inline the calls
+template <class Controller>
+int Arena::step(float dt, Controller** controllers) {
+	this->tick++;
+
+	// move paddles along their edges
+	for (int e = 0; e < this->sides; e++) {
+		int owner = this->edgeOwner[e];
+		if (owner < 0 || controllers[owner] == nullptr) {
+			continue;
+		}
+		int tracked = this->trackBall(e);
+		ControllerView view;
+		view.position = this->paddleAlong[owner] - this->paddleHalfLength;
+		view.length = this->paddleHalfLength * 2.0f;
+		view.target = view.position + this->paddleHalfLength;
+		view.distance = 0.0f;
+		view.range = ARENA_RADIUS * 2.0f;
+		view.tick = this->tick;
+		if (tracked >= 0) {
+			float dx = this->ballX[tracked] - this->edgeStart[e].x;
+			float dy = this->ballY[tracked] - this->edgeStart[e].y;
+			view.target = dx * this->edgeTangent[e].x + dy * this->edgeTangent[e].y;
+			view.distance = dx * this->edgeNormal[e].x + dy * this->edgeNormal[e].y;
+		}
+		float direction = controllers[owner]->decide(view);
+		direction = max(-1.0f, min(1.0f, direction));
+		float along = this->paddleAlong[owner] + direction * this->paddleSpeed * dt;
+		this->paddleAlong[owner] = max(this->paddleHalfLength, min(this->edgeLength - this->paddleHalfLength, along));
+	}
+
+	// move balls
+	for (int i = 0; i < this->ballCount; i++) {
+		this->ballX[i] += this->ballVX[i] * dt;
+		this->ballY[i] += this->ballVY[i] * dt;
+	}
+
+	for (int e = 0; e < this->sides; e++) {
+		if (this->edgeOwner[e] >= 0) {
+			this->collidePaddle(e);
+		}
+		this->collideEdge(e);
+	}
+
+	// keep the same number of balls in play
+	while (this->ballCount < this->ballTarget) {
+		this->serveBall(this->ballCount++);
+	}
+
+	for (int p = 0; p < this->players; p++) {
+		if (this->scoreboard.getScore(p) >= ARENA_WIN_SCORE) {
+			return p + 1;
+		}
+	}
+	return 0;
+}
+
+void Arena::draw(Canvas* canvas) {
+	// edges, dim for goals and bright for walls
+	for (int e = 0; e < this->sides; e++) {
+		this->edgeShape.setPosition(this->edgeStart[e]);
+		this->edgeShape.setRotation(atan2(this->edgeTangent[e].y, this->edgeTangent[e].x) * 180.0f / (float)PI);
+		this->edgeShape.setFillColor(this->edgeOwner[e] >= 0 ? Color(90, 90, 140) : Color::White);
+		canvas->draw(this->edgeShape);
+	}
+
+	for (int e = 0; e < this->sides; e++) {
+		int owner = this->edgeOwner[e];
+		if (owner < 0) {
+			continue;
+		}
+		Vector2f c = this->edgeStart[e] + this->edgeTangent[e] * this->paddleAlong[owner] +
+			this->edgeNormal[e] * (this->paddleInset - this->paddleHalfThickness);
+		this->paddleShape.setPosition(c);
+		this->paddleShape.setRotation(atan2(this->edgeTangent[e].y, this->edgeTangent[e].x) * 180.0f / (float)PI);
+		// spread the players around the color wheel, player 0 stays white
+		if (owner == 0) {
+			this->paddleShape.setFillColor(Color::White);
+		}
+		else {
+			float hue = owner * 6.0f / this->players;
+			float f = hue - floor(hue);
+			Uint8 up = (Uint8)(255 * f);
+			Uint8 down = (Uint8)(255 * (1.0f - f));
+			Color colors[6] = { Color(255, up, 0), Color(down, 255, 0), Color(0, 255, up), Color(0, down, 255), Color(up, 0, 255), Color(255, 0, down) };
+			this->paddleShape.setFillColor(colors[(int)hue % 6]);
+		}
+		canvas->draw(this->paddleShape);
+	}
+
+	for (int i = 0; i < this->ballCount; i++) {
+		this->ballShape.setPosition(this->ballX[i] - this->ballRadius, this->ballY[i] - this->ballRadius);
+		canvas->draw(this->ballShape);
+	}
+
+	this->scoreboard.draw(canvas);
+}
+
+/*
+Scene classes for SFML Pong
+The menu, gameplay, game over and pause screens are scenes on a stack, only the top one gets input.
+enter() and exit() run once when a scene is pushed or removed, resume() runs when the scene above it is popped.
+Scenes that are not animated are only redrawn after input, the main loop blocks in waitEvent otherwise.
+*/
+class SceneStack;
+
+class Scene {
+public:
+	virtual ~Scene() {}
+	virtual void enter() {}
+	virtual void exit() {}
+	virtual void resume() {}
+	virtual void handleEvent(Event& event) = 0;
+	virtual void update(float) {}
+	virtual void draw(Canvas* canvas) = 0;
+	virtual bool isAnimated() = 0;
+	void setStack(SceneStack* stack);
+protected:
+	SceneStack* stack;
+};
+
+void Scene::setStack(SceneStack* stack) {
+	this->stack = stack;
+}
+
+class SceneStack {
+public:
+	SceneStack();
+	void push(Scene* scene);
+	void pop();
+	void replace(Scene* scene);
+	Scene* top();
+	bool isEmpty();
+	void dispatch(Event& event);
+	void requestRedraw();
+	bool needsRedraw();
+	void clearRedraw();
+	void drawBelow(Scene* scene, Canvas* canvas);
+private:
+	vector<Scene*> scenes; // scenes are owned by main, the stack only points at them
+	bool redraw;
+};
+
+SceneStack::SceneStack() {
+	this->redraw = true;
+}
+
+void SceneStack::push(Scene* scene) {
+	scene->setStack(this);
+	this->scenes.push_back(scene);
+	scene->enter();
+	this->redraw = true;
+}
+
+void SceneStack::pop() {
+	if (this->scenes.empty()) {
+		return;
+	}
+	Scene* scene = this->scenes.back();
+	this->scenes.pop_back();
+	scene->exit();
+	if (!this->scenes.empty()) {
+		this->scenes.back()->resume();
+	}
+	this->redraw = true;
 }
 
-void Ball::setVelocity(Vector2f velocity) {
-	this->velocity = velocity;
+void SceneStack::replace(Scene* scene) {
+	// swap the top scene without resuming the one underneath
+	if (!this->scenes.empty()) {
+		Scene* old = this->scenes.back();
+		this->scenes.pop_back();
+		old->exit();
+	}
+	this->push(scene);
 }
 
-Vector2f Ball::getVelocity() {
-	return this->velocity;
+Scene* SceneStack::top() {
+	if (this->scenes.empty()) {
+		return nullptr;
+	}
+	return this->scenes.back();
 }
 
-void Ball::randomizeStartVelocity() {
-	float theta = rand() % 11 + 1; // rand 1-10
-	theta = (theta / 10) * (PI / 4.0f); // rand 0-Pi/4
-	float newX = cos(theta) * this->baseSpeed;
-	float newY = sin(theta) * this->baseSpeed;
+bool SceneStack::isEmpty() {
+	return this->scenes.empty();
+}
 
-	int flipY = rand() % 2; // 50% chance to flip y
-	if (flipY == 0) {
-		newY *= -1;
+void SceneStack::dispatch(Event& event) {
+	if (event.type == Event::Resized || event.type == Event::GainedFocus) {
+		this->redraw = true; // window contents may be stale
 	}
-	int flipX = rand() % 2; // 50% chance to flip x (shoot at other player)
-	if (flipX == 0) {
-		newX *= -1;
+	else if (!this->scenes.empty()) {
+		this->scenes.back()->handleEvent(event);
 	}
+}
 
-	this->velocity = Vector2f(newX, newY);
+void SceneStack::requestRedraw() {
+	this->redraw = true;
 }
 
-void Ball::setPosition(Vector2f newPosition) {
-	this->position = newPosition;
+bool SceneStack::needsRedraw() {
+	return this->redraw;
 }
 
-void Ball::setRadius(float newrad) {
-	if (newrad >= 1) { // check to make sure ball would be visible
-		this->radius = newrad;
+void SceneStack::clearRedraw() {
+	this->redraw = false;
+}
+
+void SceneStack::drawBelow(Scene* scene, Canvas* canvas) {
+	// for overlays, draws whatever is under scene
+	for (size_t i = 1; i < this->scenes.size(); i++) {
+		if (this->scenes[i] == scene) {
+			this->scenes[i - 1]->draw(canvas);
+			return;
+		}
 	}
-	this->shape.setRadius(this->radius);
 }
 
-void Ball::bounce(Paddle p) {
-	// calculate current magnitude and accelerate
-	float currentX = this->velocity.x; // current x and y components
-	float currentY = this->velocity.y;
-	float currentMagnitude = sqrt(currentX * currentX + currentY * currentY); // distance formula for magnitude of velocity
-	currentMagnitude *= 1.1f; // 10% increase in speed each bounce
+class MenuScene : public Scene {
+public:
+	MenuScene(RenderWindow* window, Game* game, Scene* playing, const Font& titleFont, const Font& textFont, const Texture* background);
+	void setMode(int mode, PaddleController* left, PaddleController* right);
+	void setArena(Arena* arena, Scene* arenaScene);
+	void handleEvent(Event& event);
+	void draw(Canvas* canvas);
+	bool isAnimated();
+private:
+	void updateMenuText();
+	RenderWindow* window;
+	Game* game;
+	Scene* playing;
+	PaddleController* modes[3][2]; // left and right controllers for menu choices 1-3
+	Arena* arena;
+	Scene* arenaScene;
+	int arenaPlayers;
+	unique_ptr<PlannerController> expert; // replaces the left AI in 1 player mode, built the first time it is chosen
+	bool expertChosen;
+	Sprite background;
+	Text titleText;
+	Text titleTextShadow;
+	Text menuText;
+	Text menuTextShadow;
+};
 
-	// calculate new angle
-	float midP = p.getPosition().y + p.getSize().y / 2.0f; // midpoint of the paddle (y)
-	float spread = abs(midP - this->position.y); // distance from midpoint y to ball center y
-	float ratio = spread / (p.getSize().y / 2.0f); // ratio of distance to total paddle height (between 0-1)
-	float theta = ratio * 75.0f; // angle of exit based on ratio (min 0, max 80)
-	if (theta > 75.0f) {
-		theta = 75.0f;
+MenuScene::MenuScene(RenderWindow* window, Game* game, Scene* playing, const Font& titleFont, const Font& textFont, const Texture* background) {
+	this->window = window;
+	this->game = game;
+	this->playing = playing;
+	for (int i = 0; i < 3; i++) {
+		this->modes[i][0] = nullptr;
+		this->modes[i][1] = nullptr;
 	}
-	theta = theta * (PI / 180.0f); // convert to radians
-	if (currentY < 0) { // flip angle to reflect y
-		theta *= -1.0f;
+	this->arena = nullptr;
+	this->arenaScene = nullptr;
+	this->arenaPlayers = 4;
+	this->expertChosen = false;
+
+	if (background != nullptr) {
+		this->background = Sprite(*background);
 	}
+	this->background.setPosition(0.0f, 0.0f);
 
-	// calculate new x and y comps
-	float newX = cos(theta) * currentMagnitude; // determine new x and y components with accelerated magnitude
-	float newY = sin(theta) * currentMagnitude;
-	if (currentX > 0) { // flip X (newX will always come out positive)
-		newX *= -1;
+	this->titleText.setFont(titleFont);
+	this->titleText.setString("SPACE PONG");
+	this->titleText.setFillColor(Color::White);
+	this->titleText.setCharacterSize(60);
+	this->titleText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 275.0f, WINDOW_HEIGHT / 2.0f - 150.0f));
+	this->titleText.rotate(-7.5f);
+
+	this->titleTextShadow = this->titleText;
+	this->titleTextShadow.setFillColor(Color::Red);
+	this->titleTextShadow.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 275.0f - 3.0f, WINDOW_HEIGHT / 2.0f - 150.0f - 3.0f));
+
+	this->menuText.setFont(textFont);
+	this->menuText.setFillColor(Color::White);
+	this->menuText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 100.0f, WINDOW_HEIGHT / 2.0f - 80.0f));
+
+	this->menuTextShadow = this->menuText;
+	this->menuTextShadow.setFillColor(Color::Red);
+	this->menuTextShadow.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 100.0f - 2.0f, WINDOW_HEIGHT / 2.0f - 80.0f - 2.0f));
+	this->updateMenuText();
+}
+
+void MenuScene::updateMenuText() {
+	string text = string("1  Play vs AI") + (this->expertChosen ? " (expert)" : "") + "\n2  Play vs Human\n3  Demo mode\n4  Arena, " + to_string(this->arenaPlayers) + " players  < >\n5  Exit";
+	this->menuText.setString(text);
+	this->menuTextShadow.setString(text);
+}
+
+void MenuScene::setArena(Arena* arena, Scene* arenaScene) {
+	this->arena = arena;
+	this->arenaScene = arenaScene;
+}
+
+void MenuScene::setMode(int mode, PaddleController* left, PaddleController* right) {
+	// mode 1 is 1 player, 2 is 2 player, 3 is demo
+	this->modes[mode - 1][0] = left;
+	this->modes[mode - 1][1] = right;
+}
+
+void MenuScene::handleEvent(Event& event) {
+	if (event.type != Event::KeyPressed) {
+		return;
+	}
+	int mode = 0;
+	if (event.key.code == Keyboard::Num1) { // 1 player mode
+		mode = 1;
 	}
+	else if (event.key.code == Keyboard::Num2) { // 2 player mode
+		mode = 2;
+	}
+	else if (event.key.code == Keyboard::Num3) { // demo
+		mode = 3;
+	}
+	if (mode != 0) {
+		this->game->setPlayback(nullptr); // menu games are always live
+		PaddleController* left = this->modes[mode - 1][0];
+		if (mode == 1 && this->expertChosen) {
+			left = this->expert.get();
+		}
+		this->game->setControllers(left, this->modes[mode - 1][1]);
+		this->stack->replace(this->playing);
+	}
+	else if (event.key.code == Keyboard::E) {
+		// toggle the planner AI for 1 player mode, its thread pool only starts once someone asks for it
+		this->expertChosen = !this->expertChosen;
+		if (this->expertChosen && !this->expert) {
+			this->expert.reset(new PlannerController(this->game, -1, PLANNER_BUDGET_MS));
+		}
+		this->updateMenuText();
+		this->stack->requestRedraw();
+	}
+	else if (event.key.code == Keyboard::Left || event.key.code == Keyboard::Right) {
+		// pick the number of arena players
+		int change = event.key.code == Keyboard::Left ? -1 : 1;
+		this->arenaPlayers = max(2, min(MAX_ARENA_PLAYERS, this->arenaPlayers + change));
+		this->updateMenuText();
+		this->stack->requestRedraw();
+	}
+	else if (event.key.code == Keyboard::Num4 && this->arena != nullptr) {
+		this->arena->setup(this->arenaPlayers, max(1, this->arenaPlayers / 3)); // more players, more balls
+		this->stack->replace(this->arenaScene);
+	}
+	else if (event.key.code == Keyboard::Num5) {
+		this->window->close();
+	}
+}
 
-	// set new velocity
-	this->velocity = Vector2f(newX, newY);
+void MenuScene::draw(Canvas* canvas) {
+	if (this->background.getTexture() != nullptr) {
+		canvas->draw(this->background);
+	}
+	canvas->draw(this->titleTextShadow);
+	canvas->draw(this->titleText);
+	canvas->draw(this->menuTextShadow);
+	canvas->draw(this->menuText);
 }
 
-void Ball::bounceSimple() { // no angle change calcs
-	this->velocity = Vector2f(-1.0f * this->velocity.x, this->velocity.y);
+bool MenuScene::isAnimated() {
+	return false;
 }
 
-void Ball::update(float dt) {
-	this->position.x += this->velocity.x * dt;
-	this->position.y += this->velocity.y * dt;
+class GameOverScene : public Scene {
+public:
+	GameOverScene(Game* game, Scene* playing, Scene* menu, const Font& font);
+	void setWinner(int winner);
+	void enter();
+	void handleEvent(Event& event);
+	void draw(Canvas* canvas);
+	bool isAnimated();
+private:
+	Game* game;
+	Scene* playing;
+	Scene* menu;
+	int winner;
+	Text gameOverText;
+	Text spaceBarText;
+};
 
-	// kooky colors
-	if (this->colorCycleCount > 3) {
-		this->colorCycleCount = 0;
-		this->shape.setFillColor(Color(rand(), rand(), rand()));
+GameOverScene::GameOverScene(Game* game, Scene* playing, Scene* menu, const Font& font) {
+	this->game = game;
+	this->playing = playing;
+	this->menu = menu;
+	this->winner = 0;
+
+	this->gameOverText.setFont(font);
+	this->gameOverText.setString("");
+	this->gameOverText.setCharacterSize(20);
+	this->gameOverText.setFillColor(Color::White);
+	this->gameOverText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT));
+
+	this->spaceBarText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 300.0f, WINDOW_HEIGHT / 2.0f));
+	this->spaceBarText.setFont(font);
+	this->spaceBarText.setString("Press space to play again\n  or press Esc for menu");
+	this->spaceBarText.setCharacterSize(10);
+	this->spaceBarText.setFillColor(Color::White);
+}
+
+void GameOverScene::setWinner(int winner) {
+	this->winner = winner;
+}
+
+void GameOverScene::enter() {
+	if (this->winner < 0) {
+		this->gameOverText.setString("Left player wins");
+		this->gameOverText.setPosition(Vector2f(15.0f, WINDOW_HEIGHT - 30.0f));
 	}
 	else {
-		this->colorCycleCount++;
+		this->gameOverText.setString("Right player wins");
+		this->gameOverText.setPosition(Vector2f(WINDOW_WIDTH - 320.0f, WINDOW_HEIGHT - 30.0f));
 	}
 
-	// check x bounds
-	if (this->position.x + this->radius > WINDOW_WIDTH) {
-		this->offScreen = 1;
+	// stop drawing balls and powerups but do reset for next game, once
+	this->game->resetBoard();
+}
+
+void GameOverScene::handleEvent(Event& event) {
+	if (event.type != Event::KeyPressed) {
+		return;
 	}
-	else if (this->position.x - this->radius < 0) {
-		this->offScreen = -1;
+	if (event.key.code == Keyboard::Space) {
+		this->stack->replace(this->playing); // start new game, same settings
 	}
-	else {
-		this->offScreen = 0;
+	else if (event.key.code == Keyboard::Escape) {
+		this->stack->replace(this->menu); // return to menu
 	}
+}
 
-	// check y bounds
-	if (this->position.y + this->radius > WINDOW_HEIGHT) { // if below window
-		this->position.y = WINDOW_HEIGHT - this->radius; // set to window bottom and flip
-		this->velocity.y *= -1;
+void GameOverScene::draw(Canvas* canvas) {
+	this->game->drawBoard(canvas);
+	canvas->draw(this->gameOverText);
+	canvas->draw(this->spaceBarText);
+}
+
+bool GameOverScene::isAnimated() {
+	return false;
+}
+
+class PausedScene : public Scene {
+public:
+	PausedScene(Scene* menu, const Font& font);
+	void handleEvent(Event& event);
+	void draw(Canvas* canvas);
+	bool isAnimated();
+private:
+	Scene* menu;
+	Text pausedText;
+};
+
+PausedScene::PausedScene(Scene* menu, const Font& font) {
+	this->menu = menu;
+
+	this->pausedText.setFont(font);
+	this->pausedText.setString("Paused\n\nPress P to resume\n or Esc for menu");
+	this->pausedText.setCharacterSize(10);
+	this->pausedText.setFillColor(Color::White);
+	this->pausedText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 300.0f, WINDOW_HEIGHT / 2.0f));
+}
+
+void PausedScene::handleEvent(Event& event) {
+	if (event.type != Event::KeyPressed) {
+		return;
 	}
-	else if (this->position.y - this->radius < 0) { // if above window
-		this->position.y = this->radius; // set to window top and flip
-		this->velocity.y *= -1;
+	if (event.key.code == Keyboard::P) {
+		this->stack->pop(); // back to the game where it left off
+	}
+	else if (event.key.code == Keyboard::Escape) {
+		this->stack->pop();
+		this->stack->replace(this->menu); // abandon the match
+	}
+}
+
+void PausedScene::draw(Canvas* canvas) {
+	this->stack->drawBelow(this, canvas); // the paused game or arena, frozen
+	canvas->draw(this->pausedText);
+}
+
+bool PausedScene::isAnimated() {
+	return false;
+}
+
+class PlayingScene : public Scene {
+public:
+	PlayingScene(Game* game);
+	void setScenes(GameOverScene* gameOver, Scene* paused);
+	void enter();
+	void resume();
+	void handleEvent(Event& event);
+	void update(float dt);
+	void draw(Canvas* canvas);
+	bool isAnimated();
+private:
+	Game* game;
+	GameOverScene* gameOver;
+	Scene* paused;
+};
+
+PlayingScene::PlayingScene(Game* game) {
+	this->game = game;
+	this->gameOver = nullptr;
+	this->paused = nullptr;
+}
+
+void PlayingScene::setScenes(GameOverScene* gameOver, Scene* paused) {
+	this->gameOver = gameOver;
+	this->paused = paused;
+}
+
+void PlayingScene::enter() {
+	this->game->newMatch();
+}
+
+void PlayingScene::resume() {
+	// keys may have been released while paused
+	this->game->resetControllers();
+}
+
+void PlayingScene::handleEvent(Event& event) {
+	if (event.type == Event::KeyPressed && event.key.code == Keyboard::P) {
+		this->stack->push(this->paused);
+	}
+	else if (event.type == Event::KeyPressed || event.type == Event::KeyReleased) {
+		this->game->handleEvent(event); // controllers pick out their own keys
+	}
+	else if (event.type == Event::LostFocus) {
+		this->stack->push(this->paused); // key releases would be missed while unfocused
+	}
+}
+
+void PlayingScene::update(float dt) {
+	int winner = this->game->update(dt);
+	if (winner != 0) {
+		this->gameOver->setWinner(winner);
+		this->stack->replace(this->gameOver);
+	}
+}
+
+void PlayingScene::draw(Canvas* canvas) {
+	this->game->draw(canvas);
+}
+
+bool PlayingScene::isAnimated() {
+	return true;
+}
+
+class ArenaScene : public Scene {
+public:
+	ArenaScene(Arena* arena, Scene* menu, Scene* paused, const Font& font);
+	void enter();
+	void resume();
+	void handleEvent(Event& event);
+	void update(float dt);
+	void draw(Canvas* canvas);
+	bool isAnimated();
+private:
+	Arena* arena;
+	Scene* menu;
+	Scene* paused;
+	int winner; // player + 1, 0 while the match is on
+	Text winnerText;
+};
+
+ArenaScene::ArenaScene(Arena* arena, Scene* menu, Scene* paused, const Font& font) {
+	this->arena = arena;
+	this->menu = menu;
+	this->paused = paused;
+	this->winner = 0;
+
+	this->winnerText.setFont(font);
+	this->winnerText.setCharacterSize(10);
+	this->winnerText.setFillColor(Color::White);
+	this->winnerText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 150.0f, WINDOW_HEIGHT / 2.0f - 20.0f));
+}
+
+void ArenaScene::enter() {
+	this->winner = 0;
+	this->arena->newMatch();
+}
+
+void ArenaScene::resume() {
+	this->arena->resetControllers();
+}
+
+void ArenaScene::handleEvent(Event& event) {
+	if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape) {
+		this->stack->replace(this->menu);
+	}
+	else if (this->winner != 0) {
+		if (event.type == Event::KeyPressed && event.key.code == Keyboard::Space) {
+			this->enter(); // play again, same players
+			this->stack->requestRedraw();
+		}
+	}
+	else if (event.type == Event::KeyPressed && event.key.code == Keyboard::P) {
+		this->stack->push(this->paused);
+	}
+	else if (event.type == Event::KeyPressed || event.type == Event::KeyReleased) {
+		this->arena->handleEvent(event);
+	}
+	else if (event.type == Event::LostFocus) {
+		this->stack->push(this->paused);
+	}
+}
+
+void ArenaScene::update(float dt) {
+	this->winner = this->arena->update(dt);
+	if (this->winner != 0) {
+		this->winnerText.setString("Player " + to_string(this->winner) + " wins\n\nPress space to play again\n  or press Esc for menu");
+	}
+}
+
+void ArenaScene::draw(Canvas* canvas) {
+	this->arena->draw(canvas);
+	if (this->winner != 0) {
+		canvas->draw(this->winnerText);
+	}
+}
+
+bool ArenaScene::isAnimated() {
+	return this->winner == 0; // sleeps on the final board once someone wins
+}
+
+/*
+Headless batch runner for SFML Pong
+Plays AI vs AI matches with a fixed timestep and no window as fast as possible, and reports the throughput
+*/
+const float BATCH_DT_MS = 16.0f;
+const int BATCH_MAX_TICKS = 100000; // safety stop for a match that never ends
+
+int runBatch(int matches, TelemetryLogger* telemetry, string powerUpFile, bool expert) {
+	// no window, so no fonts, textures or sounds
+	Font font;
+	Game game(font, nullptr, nullptr);
+	if (!game.loadPowerUps(powerUpFile)) {
+		cerr << "Could not load " << powerUpFile << ", using the default powerups" << endl;
+	}
+	AiController leftAi;
+	AiController rightAi;
+	unique_ptr<PlannerController> planner; // only with --expert, it starts a thread pool
+	game.setControllers(&leftAi, &rightAi);
+	game.setTelemetry(telemetry);
+	if (expert) {
+		planner.reset(new PlannerController(&game, 1, PLANNER_BUDGET_MS));
+		game.setControllers(&leftAi, planner.get());
+	}
+
+	Clock clock;
+	uint64_t ticks = 0;
+	int leftWins = 0;
+	int rightWins = 0;
+	for (int m = 0; m < matches; m++) {
+		game.newMatch();
+		for (int t = 0; t < BATCH_MAX_TICKS; t++) {
+			ticks++;
+			int winner = expert ? game.step(BATCH_DT_MS, leftAi, *planner) : game.step(BATCH_DT_MS, leftAi, rightAi); // static dispatch, controller calls inline
+			if (winner < 0) {
+				leftWins++;
+				break;
+			}
+			else if (winner > 0) {
+				rightWins++;
+				break;
+			}
+		}
+	}
+	float seconds = clock.getElapsedTime().asSeconds();
+
+	cout << matches << " matches (" << leftWins << " left, " << rightWins << " right), " << ticks << " ticks in " << seconds << " s" << endl;
+	if (seconds > 0.0f) {
+		cout << ticks / seconds << " ticks/s, " << matches / seconds << " matches/s" << endl;
+	}
+	if (expert && planner->getDecisions() > 0) {
+		cout << "planner on the right: " << planner->getThreads() << " threads, " << planner->getDecisions() << " decisions, " <<
+			planner->getRollouts() / planner->getDecisions() << " rollouts per decision, " <<
+			planner->getTotalDecisionMs() / planner->getDecisions() << " ms mean, " << planner->getMaxDecisionMs() << " ms max" << endl;
+	}
+	return 0;
+}
+
+/*
+Headless arena benchmark for SFML Pong
+Times Arena ticks with AI players and a fixed timestep, a new match starts whenever one ends
+*/
+const int ARENA_BENCH_TICKS = 10000;
+
+int runArenaBench(int players, int balls) {
+	Font font;
+	Arena arena(font);
+	AiController ai[MAX_ARENA_PLAYERS];
+	AiController* controllers[MAX_ARENA_PLAYERS];
+	for (int p = 0; p < MAX_ARENA_PLAYERS; p++) {
+		controllers[p] = &ai[p];
+	}
+	arena.setup(players, balls);
+
+	Clock clock;
+	int64_t total = 0;
+	int64_t worst = 0;
+	int matches = 0;
+	for (int t = 0; t < ARENA_BENCH_TICKS; t++) {
+		clock.restart();
+		int winner = arena.step(BATCH_DT_MS, controllers); // static dispatch, controller calls inline
+		int64_t us = clock.getElapsedTime().asMicroseconds();
+		total += us;
+		worst = max(worst, us);
+		if (winner != 0) {
+			matches++;
+			arena.newMatch();
+		}
+	}
+
+	cout << arena.getPlayers() << " players, " << arena.getBallCount() << " balls, " << ARENA_BENCH_TICKS << " ticks, " << matches << " matches finished" << endl;
+	cout << "tick mean " << (double)total / ARENA_BENCH_TICKS << " us, max " << worst << " us" << endl;
+	return 0;
+}
+
+/*
+Headless replay capture for SFML Pong
+Plays a recorded match into an offscreen texture and captures it at a steady frame rate, as fast as the writer keeps up
+*/
+int renderReplay(string replayFile, string outFile, string powerUpFile) {
+	Replay replay;
+	if (!replay.load(replayFile)) {
+		cerr << "Could not load replay " << replayFile << endl;
+		return -1;
+	}
+
+	// loaded directly, no window to show a loading screen in
+	Font font;
+	if (!font.loadFromFile("arial.ttf")) {
+		cerr << "Could not load arial.ttf" << endl;
+		return -1;
+	}
+	Texture background;
+	background.loadFromFile("spacebg2.png");
+
+	RenderTexture target;
+	if (!target.create(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+		cerr << "Could not create an offscreen render target" << endl;
+		return -1;
+	}
+
+	TargetCanvas targetCanvas(&target);
+
+	Game game(font, &background, nullptr);
+	if (!game.loadPowerUps(powerUpFile)) {
+		cerr << "Could not load " << powerUpFile << ", using the default powerups" << endl;
+	}
+	ReplayController left(&replay, -1);
+	ReplayController right(&replay, 1);
+	game.setPlayback(&replay);
+	game.setControllers(&left, &right);
+
+	FrameCapture capture;
+	capture.setMusic("pongdraft02.wav");
+	if (!capture.open(outFile, WINDOW_WIDTH, WINDOW_HEIGHT, CAPTURE_WAIT)) {
+		cerr << "Could not open " << outFile << endl;
+		return -1;
+	}
+	game.setCapture(&capture);
+	game.newMatch();
+
+	// replay ticks have the recorded frame times, emit a frame each time play passes the next 1/60 s
+	Clock clock;
+	float playedMs = 0.0f;
+	float nextFrameMs = 0.0f;
+	for (int t = 0; t < replay.getTickCount(); t++) {
+		int winner = game.step(BATCH_DT_MS, left, right); // playback overrides the timestep
+		playedMs += replay.getDt(t);
+		while (playedMs >= nextFrameMs) {
+			target.clear(Color(0, 0, 0, 255));
+			game.draw(&targetCanvas);
+			target.display();
+			target.setActive(true);
+			capture.grab();
+			nextFrameMs += 1000.0f / CAPTURE_FPS;
+		}
+		if (winner != 0) {
+			break;
+		}
+	}
+	target.setActive(true);
+	capture.close();
+	float seconds = clock.getElapsedTime().asSeconds();
+
+	cout << capture.getFramesWritten() << " frames written, " << capture.getFramesDropped() << " dropped, " <<
+		playedMs / 1000.0f << " s of play in " << seconds << " s";
+	if (seconds > 0.0f) {
+		cout << " (" << playedMs / 1000.0f / seconds << "x real time)";
+	}
+	cout << endl;
+	return 0;
+}
+
+/*
+Software render benchmark for SFML Pong
+Draws the menu, a 1v1 match and a 16 player multiball arena into a software canvas and reports frames per second.
+Each scene's frames are hashed into one checksum, which can be saved as goldens and checked later to catch rendering
+changes. Frames only depend on this file, the background is generated here and matches are seeded, but rand() and
+float math differ between compilers so goldens should be made on the machine that checks them.
+*/
+const int RENDER_BENCH_FRAMES = 300;
+const unsigned RENDER_BENCH_SEED = 230;
+
+void makeBenchBackground(Image* image) {
+	// dark gradient with a fixed starfield
+	image->create(WINDOW_WIDTH, WINDOW_HEIGHT, Color::Black);
+	for (int y = 0; y < WINDOW_HEIGHT; y++) {
+		for (int x = 0; x < WINDOW_WIDTH; x++) {
+			image->setPixel(x, y, Color(10, 5, (Uint8)(20 + 40 * y / WINDOW_HEIGHT)));
+		}
+	}
+	uint32_t seed = RENDER_BENCH_SEED;
+	for (int i = 0; i < 400; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		int x = (int)(seed >> 8) % WINDOW_WIDTH;
+		seed = seed * 1664525u + 1013904223u;
+		int y = (int)(seed >> 8) % WINDOW_HEIGHT;
+		Uint8 bright = (Uint8)(128 + (seed >> 25));
+		image->setPixel(x, y, Color(bright, bright, bright));
+	}
+}
+
+uint64_t benchScene(SoftwareCanvas* canvas, string name, function<void(Canvas*)> draw, function<void()> advance, string framePrefix) {
+	// only drawing and rasterizing is timed, the game steps between frames
+	uint64_t checksum = 14695981039346656037ull;
+	int64_t total = 0;
+	int64_t worst = 0;
+	Clock clock;
+	for (int f = 0; f < RENDER_BENCH_FRAMES; f++) {
+		clock.restart();
+		canvas->clear(Color(0, 0, 0, 255));
+		draw(canvas);
+		canvas->display();
+		int64_t us = clock.getElapsedTime().asMicroseconds();
+		total += us;
+		worst = max(worst, us);
+		checksum = (checksum ^ canvas->getChecksum()) * 1099511628211ull;
+		if (f == RENDER_BENCH_FRAMES - 1 && framePrefix != "" && !canvas->save(framePrefix + name + ".ppm")) {
+			cerr << "Could not write " << framePrefix << name << ".ppm" << endl;
+		}
+		advance();
+	}
+
+	cout << name << ": " << RENDER_BENCH_FRAMES << " frames, mean " << (double)total / RENDER_BENCH_FRAMES << " us, max " << worst << " us";
+	if (total > 0) {
+		cout << ", " << RENDER_BENCH_FRAMES * 1000000.0 / total << " fps";
 	}
+	cout << ", checksum " << hex << checksum << dec << endl;
+	return checksum;
 }
 
-void Ball::draw(RenderWindow* window) {
-	// correct for SHAPE POSITION top-left origin
-	this->shape.setPosition(Vector2f(this->position.x - this->radius, this->position.y - this->radius));
-	window->draw(this->shape);
-}
+int runRenderBench(unsigned width, unsigned height, int threads, string goldenOut, string goldenIn, string framePrefix) {
+	// no window or GPU, so no textures either, the canvas draws the background image itself
+	Font font;
+	Image background;
+	makeBenchBackground(&background);
+	SoftwareCanvas canvas(width, height, threads);
+	cout << "Software canvas " << width << "x" << height << ", " << canvas.getThreads() << " threads" << endl;
 
-Vector2f Ball::getPosition() {
-	return Vector2f(this->position.x, this->position.y);
-}
+	Game game(font, nullptr, nullptr); // default powerups, not whatever powerups.cfg holds
+	AiController leftAi;
+	AiController rightAi;
+	game.setControllers(&leftAi, &rightAi);
+	MenuScene menu(nullptr, &game, nullptr, font, font, nullptr);
 
-float Ball::getRadius() {
-	return this->radius;
-}
+	AiController ai[MAX_ARENA_PLAYERS];
+	AiController* controllers[MAX_ARENA_PLAYERS];
+	for (int p = 0; p < MAX_ARENA_PLAYERS; p++) {
+		controllers[p] = &ai[p];
+	}
+	Arena arena(font);
+
+	vector<pair<string, uint64_t> > results;
+	results.push_back(make_pair("menu", benchScene(&canvas, "menu",
+		[&](Canvas* c) {
+			canvas.drawImage(background);
+			menu.draw(c);
+		},
+		[]() {}, framePrefix)));
+
+	srand(RENDER_BENCH_SEED);
+	game.newMatch();
+	results.push_back(make_pair("gameplay", benchScene(&canvas, "gameplay",
+		[&](Canvas* c) {
+			canvas.drawImage(background);
+			game.draw(c);
+		},
+		[&]() {
+			if (game.step(BATCH_DT_MS, leftAi, rightAi) != 0) {
+				game.newMatch();
+			}
+		}, framePrefix)));
+
+	srand(RENDER_BENCH_SEED);
+	arena.setup(16, 500);
+	results.push_back(make_pair("multiball", benchScene(&canvas, "multiball",
+		[&](Canvas* c) { arena.draw(c); },
+		[&]() {
+			if (arena.step(BATCH_DT_MS, controllers) != 0) {
+				arena.newMatch();
+			}
+		}, framePrefix)));
 
+	string size = to_string(width) + "x" + to_string(height);
+	if (goldenOut != "") {
+		ofstream file(goldenOut);
+		for (size_t i = 0; i < results.size(); i++) {
+			file << size << " " << results[i].first << " " << hex << results[i].second << dec << endl;
+		}
+		if (!file) {
+			cerr << "Could not write " << goldenOut << endl;
+			return -1;
+		}
+		cout << "Goldens written to " << goldenOut << endl;
+	}
+	if (goldenIn != "") {
+		ifstream file(goldenIn);
+		if (!file) {
+			cerr << "Could not read " << goldenIn << endl;
+			return -1;
+		}
+		int checked = 0;
+		int failed = 0;
+		string goldenSize;
+		string name;
+		uint64_t checksum;
+		while (file >> goldenSize >> name >> hex >> checksum >> dec) {
+			for (size_t i = 0; i < results.size(); i++) {
+				if (goldenSize == size && results[i].first == name) {
+					checked++;
+					if (results[i].second != checksum) {
+						failed++;
+						cout << "MISMATCH " << name << ": expected " << hex << checksum << ", got " << results[i].second << dec << endl;
+					}
+				}
+			}
+		}
+		cout << checked << " goldens checked at " << size << ", " << failed << " failed" << endl;
+		if (checked == 0 || failed > 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
 
 /*
-Checks for collision between two circles
-b1p and b2p are the CENTER positions of the two circles
+Headless synth benchmark for SFML Pong
+Renders a minute of audio in the live block size with a new sound every few blocks at rising ball speeds, so
+most voices are busy, and reports the time per block against the block's length
 */
-bool collisionCircle(Vector2f b1p, float b1r, Vector2f b2p, float b2r) {
+const int AUDIO_BENCH_SECONDS = 60;
 
-	//compute distance between centers
-	float dist = sqrt( (b1p.x - b2p.x) * (b1p.x - b2p.x) + (b1p.y - b2p.y) * (b1p.y - b2p.y) );
-	float radiiSum = b1r + b2r;
-	if (dist <= radiiSum) {
-		return true;
+int runAudioBench() {
+	SynthVoices voices(SYNTH_SAMPLE_RATE);
+	float left[SYNTH_BLOCK_FRAMES];
+	float right[SYNTH_BLOCK_FRAMES];
+	int blocks = AUDIO_BENCH_SECONDS * SYNTH_SAMPLE_RATE / SYNTH_BLOCK_FRAMES;
+
+	Clock clock;
+	int64_t total = 0;
+	int64_t worst = 0;
+	int peakVoices = 0;
+	float peak = 0.0f;
+	for (int b = 0; b < blocks; b++) {
+		clock.restart();
+		float speed = 0.4f + 3.6f * (b % 600) / 600.0f;
+		voices.trigger(synthEvent(SYNTH_WALL, speed, 0.0f, (float)(b * 97 % WINDOW_WIDTH)));
+		if (b % 2 == 0) {
+			voices.trigger(synthEvent(SYNTH_IMPACT, speed, (b % 21) / 10.0f - 1.0f, b % 4 == 0 ? 15.0f : WINDOW_WIDTH - 15.0f));
+		}
+		if (b % 8 == 0) {
+			voices.trigger(synthEvent(SYNTH_POWERUP, speed, 0.0f, WINDOW_WIDTH / 2.0f));
+		}
+		memset(left, 0, sizeof(left));
+		memset(right, 0, sizeof(right));
+		voices.render(left, right, SYNTH_BLOCK_FRAMES);
+		int64_t us = clock.getElapsedTime().asMicroseconds();
+		total += us;
+		worst = max(worst, us);
+		peakVoices = max(peakVoices, voices.getActiveCount());
+		for (int i = 0; i < SYNTH_BLOCK_FRAMES; i++) {
+			peak = max(peak, max(abs(left[i]), abs(right[i])));
+		}
 	}
-	return false;
+
+	double blockUs = SYNTH_BLOCK_FRAMES * 1000000.0 / SYNTH_SAMPLE_RATE;
+	cout << blocks << " blocks of " << SYNTH_BLOCK_FRAMES << " samples, up to " << peakVoices << " voices, peak level " << peak << endl;
+	cout << "block mean " << (double)total / blocks << " us, max " << worst << " us, " <<
+		100.0 * total / (blocks * blockUs) << "% of real time" << endl;
+	return 0;
 }
 
 /*
-Checks for circle-rectangle collisions for the ball and paddle
-bp is the CENTER position of the circle, pp is the TOP LEFT of the paddle
+Telemetry report tool for SFML Pong
+Aggregates one or more telemetry files: rally lengths, peak ball speeds, powerup pickups and paddle hit regions
 */
-bool collisionRectangle(Ball *ball, Paddle *paddle) {
-	Vector2f bp = ball->getPosition();
-	float br = ball->getRadius();
-	Vector2f pp = paddle->getPosition();
-	Vector2f ps = paddle->getSize();
+int reportTelemetry(vector<string> filenames) {
+	vector<TelemetryRecord> records;
+	for (size_t i = 0; i < filenames.size(); i++) {
+		if (!readTelemetryFile(filenames[i], &records)) {
+			cerr << "Could not read telemetry file " << filenames[i] << endl;
+			return -1;
+		}
+	}
 
+	uint64_t matches = 0;
+	uint64_t points = 0;
+	uint64_t bounces = 0;
+	uint64_t pickups = 0;
+	uint64_t effectPickups[EFFECT_COUNT] = { 0, 0, 0, 0, 0 };
+	uint64_t rallyTotal = 0;
+	int rallyMax = 0;
+	uint64_t rallyBuckets[5] = { 0, 0, 0, 0, 0 }; // 0-1, 2-3, 4-7, 8-15, 16+
+	float speedPeak = 0.0f;
+	float matchSpeedPeak = 0.0f;
+	double matchSpeedPeakTotal = 0.0;
+	uint64_t regions[2][5] = { { 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0 } }; // [left, right][top edge .. bottom edge]
 
-	float testX = bp.x;
-	float testY = bp.y;
-	if (bp.x < pp.x) {
-		// ball center left from left edge
-		testX = pp.x;
-	}
-	else if (bp.x > pp.x + ps.x) {
-		// ball center right of right edge
-		testX = pp.x + ps.x;
+	for (size_t i = 0; i < records.size(); i++) {
+		const TelemetryRecord& r = records[i];
+		if (r.type == TELEMETRY_BOUNCE) {
+			bounces++;
+			if (r.speed > speedPeak) {
+				speedPeak = r.speed;
+			}
+			if (r.speed > matchSpeedPeak) {
+				matchSpeedPeak = r.speed;
+			}
+			int region = (int)((r.offset + 1.0f) / 2.0f * 5.0f);
+			region = max(0, min(4, region));
+			regions[r.side > 0 ? 1 : 0][region]++;
+		}
+		else if (r.type == TELEMETRY_SCORE) {
+			points++;
+			rallyTotal += r.rally;
+			rallyMax = max(rallyMax, (int)r.rally);
+			int bucket = 0;
+			while (bucket < 4 && r.rally >= (2 << bucket)) {
+				bucket++;
+			}
+			rallyBuckets[bucket]++;
+		}
+		else if (r.type == TELEMETRY_POWERUP) {
+			pickups++;
+			if (r.side >= 0 && r.side < EFFECT_COUNT) {
+				effectPickups[r.side]++;
+			}
+		}
+		else if (r.type == TELEMETRY_MATCH_END) {
+			matches++;
+			matchSpeedPeakTotal += matchSpeedPeak;
+			matchSpeedPeak = 0.0f;
+		}
 	}
-	// else ball center within x range
 
-	if (bp.y < pp.y) {
-		// ball center up from top edge
-		testY = pp.y;
+	cout << records.size() << " records, " << matches << " matches, " << points << " points, " << bounces << " paddle hits" << endl;
+	if (points > 0) {
+		cout << "Rally length: mean " << (double)rallyTotal / points << ", max " << rallyMax << endl;
+		cout << "  0-1: " << rallyBuckets[0] << "  2-3: " << rallyBuckets[1] << "  4-7: " << rallyBuckets[2]
+			<< "  8-15: " << rallyBuckets[3] << "  16+: " << rallyBuckets[4] << endl;
 	}
-	else if (bp.y > pp.y + ps.y) {
-		// ball center down from bottom edge
-		testY = pp.y + ps.y;
+	cout << "Peak ball speed: " << speedPeak << " px/ms";
+	if (matches > 0) {
+		cout << ", mean per-match peak " << matchSpeedPeakTotal / matches << " px/ms";
 	}
-	// else ball center within y range
-
-	// calculate pythagorean distance from ball to closest edge
-	float distX = bp.x - testX;
-	float distY = bp.y - testY;
-	float pythagDist = sqrt((distX * distX) + (distY * distY));
-	
-	if (pythagDist <= br) { // pythag collision
-		return true;
+	cout << endl;
+	if (matches > 0) {
+		cout << "Powerup pickups: " << pickups << " (" << (double)pickups / matches << " per match)" << endl;
+		const char* effects[EFFECT_COUNT] = { "multiball", "split", "grow", "shrink", "speed" };
+		cout << " ";
+		for (int e = 0; e < EFFECT_COUNT; e++) {
+			cout << " " << effects[e] << ": " << effectPickups[e];
+		}
+		cout << endl;
 	}
-	else {
-		return false;
+	const char* sides[2] = { "Left", "Right" };
+	for (int s = 0; s < 2; s++) {
+		cout << sides[s] << " paddle hits, top to bottom:";
+		for (int region = 0; region < 5; region++) {
+			cout << " " << regions[s][region];
+		}
+		cout << endl;
 	}
+	return 0;
 }
 
 /*
 Main function for SFML Pong
 Set up menu and game objects, run main game loop
 */
-int main() {
+int main(int argc, char* argv[]) {
+	Clock startupClock; // for time-to-first-frame reporting
+
+	// command line options
+	// --batch N              play N AI vs AI matches headless and report throughput
+	// --telemetry FILE       log match events to FILE
+	// --telemetry-report F.. print aggregates from telemetry files
+	// --record FILE          save each finished match as a replay
+	// --replay FILE          play a recorded match back
+	// --peer PORT            in 2 player mode the right paddle listens for a network player on PORT
+	// --powerups FILE        powerup schedule, powerups.cfg by default
+	// --arena-bench P B      time headless arena ticks with P players and B balls
+	// --expert               in batch mode the right paddle is the planner AI
+	// --capture FILE         record what is drawn to FILE (.y4m video, otherwise a PPM sequence) and a WAV
+	// --render-replay R FILE capture replay R to FILE headless
+	// --render-bench WxH     time the software renderer, threads set with --render-threads N
+	// --render-golden FILE   with --render-bench, save the frame checksums to FILE
+	// --render-check FILE    with --render-bench, compare against FILE and fail on a mismatch
+	// --render-frames PREFIX with --render-bench, save each scene's last frame as PREFIXscene.ppm
+	// --audio-bench          time the sound synth headless with most voices playing
+	int batchMatches = 0;
+	bool expert = false;
+	bool audioBench = false;
+	int benchPlayers = 0;
+	int benchBalls = 0;
+	string powerUpFile = "powerups.cfg";
+	string telemetryFile = "";
+	string recordFile = "";
+	string replayFile = "";
+	string captureFile = "";
+	string renderReplayFile = "";
+	unsigned renderWidth = 0;
+	unsigned renderHeight = 0;
+	int renderThreads = 0;
+	string goldenOut = "";
+	string goldenIn = "";
+	string framePrefix = "";
+	int peerPort = 0;
+	vector<string> reportFiles;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--batch" && i + 1 < argc) {
+			batchMatches = atoi(argv[++i]);
+		}
+		else if (arg == "--telemetry" && i + 1 < argc) {
+			telemetryFile = argv[++i];
+		}
+		else if (arg == "--record" && i + 1 < argc) {
+			recordFile = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc) {
+			replayFile = argv[++i];
+		}
+		else if (arg == "--powerups" && i + 1 < argc) {
+			powerUpFile = argv[++i];
+		}
+		else if (arg == "--peer" && i + 1 < argc) {
+			peerPort = atoi(argv[++i]);
+		}
+		else if (arg == "--capture" && i + 1 < argc) {
+			captureFile = argv[++i];
+		}
+		else if (arg == "--render-replay" && i + 2 < argc) {
+			renderReplayFile = argv[++i];
+			captureFile = argv[++i];
+		}
+		else if (arg == "--render-bench" && i + 1 < argc) {
+			// read signed so -5x5 is caught rather than wrapping to a huge width
+			istringstream size(argv[++i]);
+			int w = 0;
+			int h = 0;
+			char x = 0;
+			if (!(size >> w >> x >> h) || x != 'x' || w <= 0 || h <= 0 || w > (int)CANVAS_MAX_SIZE || h > (int)CANVAS_MAX_SIZE) {
+				cerr << "--render-bench takes a size like 1920x1080, at most " << CANVAS_MAX_SIZE << " per side" << endl;
+				return -1;
+			}
+			renderWidth = (unsigned)w;
+			renderHeight = (unsigned)h;
+		}
+		else if (arg == "--render-threads" && i + 1 < argc) {
+			renderThreads = atoi(argv[++i]);
+		}
+		else if (arg == "--render-golden" && i + 1 < argc) {
+			goldenOut = argv[++i];
+		}
+		else if (arg == "--render-check" && i + 1 < argc) {
+			goldenIn = argv[++i];
+		}
+		else if (arg == "--render-frames" && i + 1 < argc) {
+			framePrefix = argv[++i];
+		}
+		else if (arg == "--audio-bench") {
+			audioBench = true;
+		}
+		else if (arg == "--expert") {
+			expert = true;
+		}
+		else if (arg == "--arena-bench" && i + 2 < argc) {
+			benchPlayers = atoi(argv[++i]);
+			benchBalls = atoi(argv[++i]);
+		}
+		else if (arg == "--telemetry-report") {
+			while (i + 1 < argc) {
+				reportFiles.push_back(argv[++i]);
+			}
+		}
+		else {
+			cerr << "Unknown option " << arg << endl;
+			return -1;
+		}
+	}
+
+	if (!reportFiles.empty()) {
+		return reportTelemetry(reportFiles);
+	}
+	if (benchPlayers > 0) {
+		return runArenaBench(benchPlayers, benchBalls);
+	}
+	if (renderReplayFile != "") {
+		return renderReplay(renderReplayFile, captureFile, powerUpFile);
+	}
+	if (audioBench) {
+		return runAudioBench();
+	}
+	if (renderWidth > 0) {
+		return runRenderBench(renderWidth, renderHeight, renderThreads, goldenOut, goldenIn, framePrefix);
+	}
+
+	TelemetryLogger telemetry;
+	if (telemetryFile != "" && !telemetry.open(telemetryFile)) {
+		cerr << "Could not open telemetry file " << telemetryFile << endl;
+		return -1;
+	}
+
+	if (batchMatches > 0) {
+		int result = runBatch(batchMatches, telemetryFile != "" ? &telemetry : nullptr, powerUpFile, expert);
+		telemetry.close();
+		if (telemetryFile != "") {
+			cout << telemetry.getWritten() << " telemetry records written, " << telemetry.getDropped() << " dropped" << endl;
+		}
+		return result;
+	}
+
 	RenderWindow window(VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Pong"); // create window
 	window.setVerticalSyncEnabled(true);
 	window.setKeyRepeatEnabled(false); // remove repeated key events
 
-	// set up music and sfx
-	sf::SoundBuffer sfx_impact_buffer;
-	if (!sfx_impact_buffer.loadFromFile("impact.wav")) {
-		exit(-1);
-	}
-	sf::Sound sfx_impact;
-	sfx_impact.setBuffer(sfx_impact_buffer);
+	// queue up every asset, decoded in parallel off the render thread
+	AssetLoader assets;
+	int musicId = assets.add(ASSET_MUSIC, "pongdraft02.wav", true);
+	int spaceFontId = assets.add(ASSET_FONT, "spacefont.otf", false);
+	int arialFontId = assets.add(ASSET_FONT, "arial.ttf", false);
+	int menuBgId = assets.add(ASSET_TEXTURE, "spacebg.png", true);
+	int gameBgId = assets.add(ASSET_TEXTURE, "spacebg2.png", true);
+	assets.start();
 
-	sf::SoundBuffer sfx_powerup_buffer;
-	if (!sfx_powerup_buffer.loadFromFile("powerup.wav")) {
-		exit(-1);
+	// loading screen, drawn with plain shapes since the fonts are still loading
+	RectangleShape loadingBarBack(Vector2f(WINDOW_WIDTH / 2.0f, 10.0f));
+	loadingBarBack.setPosition(Vector2f(WINDOW_WIDTH / 4.0f, WINDOW_HEIGHT / 2.0f - 5.0f));
+	loadingBarBack.setFillColor(Color(60, 60, 60));
+	RectangleShape loadingBar = loadingBarBack;
+	loadingBar.setFillColor(Color(200, 0, 255));
+
+	bool firstFrame = true;
+	bool musicStarted = false;
+	while (window.isOpen() && !assets.isDone()) {
+		Event event;
+		while (window.pollEvent(event)) {
+			if (event.type == Event::Closed) {
+				window.close();
+			}
+		}
+
+		assets.update(); // upload any textures that finished decoding
+
+		// start the music as soon as it is ready, even mid-load
+		if (!musicStarted && assets.getMusic(musicId) != nullptr) {
+			assets.getMusic(musicId)->setLoop(true);
+			assets.getMusic(musicId)->play();
+			musicStarted = true;
+		}
+
+		loadingBar.setSize(Vector2f(loadingBarBack.getSize().x * assets.getProgress(), loadingBarBack.getSize().y));
+		window.clear(Color(0, 0, 0, 255));
+		window.draw(loadingBarBack);
+		window.draw(loadingBar);
+		window.display();
+
+		if (firstFrame) {
+			cout << "Time to first frame: " << startupClock.getElapsedTime().asMilliseconds() << " ms" << endl;
+			firstFrame = false;
+		}
+	}
+	if (!window.isOpen()) {
+		return 0; // closed during loading, loader waits for its workers
 	}
-	sf::Sound sfx_powerup;
-	sfx_powerup.setBuffer(sfx_powerup_buffer);
+	assets.update(); // pick up whatever finished on the last frame
+	cout << "Assets loaded in " << startupClock.getElapsedTime().asMilliseconds() << " ms" << endl;
 
-	Music music;
-	if (!music.openFromFile("pongdraft02.wav")) {
-		exit(-1);
+	if (assets.getFailedRequired() != "") {
+		window.close();
+		return -1;
 	}
-	music.setLoop(true);
-	music.play();
 
-	// set up frame clock
-	Clock clock;
-	float dt_ms = 0;
+	if (!musicStarted && assets.getMusic(musicId) != nullptr) {
+		assets.getMusic(musicId)->setLoop(true);
+		assets.getMusic(musicId)->play();
+		musicStarted = true;
+	}
 
-	// game and menu parameters
-	bool gameOver = false;
-	bool menuChosen = false;
-	int menuChoice = 0;
+	// sound effects are synthesized, nothing to load
+	Synth synth;
+	synth.play();
 
-	// key booleans for controls
-	bool upKeyPressed = false;
-	bool downKeyPressed = false;
-	bool wKeyPressed = false;
-	bool sKeyPressed = false;
+	// fonts are required, so both loaded by now
+	Font& spacefontloader = assets.getFont(spaceFontId);
+	Font& fontLoader = assets.getFont(arialFontId);
 
-	// menu setup
-	sf::Font spacefontloader;
-	if (!spacefontloader.loadFromFile("spacefont.otf"))
-	{
-		std::exit(-1);
+	// game objects and scenes
+	Game game(fontLoader, &assets.getTexture(gameBgId), &synth);
+	if (telemetryFile != "") {
+		game.setTelemetry(&telemetry);
 	}
-	sf::Font fontLoader;
-	if (!fontLoader.loadFromFile("arial.ttf"))
-	{
-		std::exit(-1);
+	if (!game.loadPowerUps(powerUpFile)) {
+		cerr << "Could not load " << powerUpFile << ", using the default powerups" << endl;
 	}
-	
-	Text titleText;
-	titleText.setFont(spacefontloader);
-	titleText.setString("SPACE PONG");
-	titleText.setFillColor(Color::White);
-	titleText.setCharacterSize(60);
-	titleText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 275.0f, WINDOW_HEIGHT / 2.0f - 150.0f));
-	titleText.rotate(-7.5f);
-	
-	Text titleTextShadow = titleText;
-	titleTextShadow.setFillColor(Color::Red);
-	titleTextShadow.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 275.0f - 3.0f, WINDOW_HEIGHT / 2.0f - 150.0f - 3.0f));
-	
-	Text menuText;
-	menuText.setFont(fontLoader);
-	menuText.setString("1  Play vs AI\n2  Play vs Human\n3  Demo mode\n4  Exit");
-	menuText.setFillColor(Color::White);
-	menuText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 100.0f, WINDOW_HEIGHT / 2.0f - 80.0f));
 
-	Text menuTextShadow = menuText;
-	menuTextShadow.setFillColor(Color::Red);
-	menuTextShadow.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 100.0f - 2.0f, WINDOW_HEIGHT / 2.0f - 80.0f - 2.0f));
-
-	// board text setup
-	Text gameOverText;
-	gameOverText.setFont(spacefontloader);
-	gameOverText.setString("");
-	gameOverText.setCharacterSize(20);
-	gameOverText.setFillColor(Color::White);
-	gameOverText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT));
+	// paddle controllers for the menu modes, human players use a joystick when one is plugged in
+	KeyboardController wsKeys(Keyboard::W, Keyboard::S);
+	KeyboardController arrowKeys(Keyboard::Up, Keyboard::Down);
+	JoystickController joystickLeft(1);
+	JoystickController joystickRight(0);
+	AiController aiLeft;
+	AiController aiRight;
+	NetworkController peer;
+	PaddleController* humanLeft = &wsKeys;
+	PaddleController* humanRight = &arrowKeys;
+	if (Joystick::isConnected(0)) {
+		humanRight = &joystickRight;
+	}
+	if (Joystick::isConnected(1)) {
+		humanLeft = &joystickLeft;
+	}
+	PaddleController* secondPlayer = humanRight;
+	if (peerPort != 0) {
+		if (peer.listen((unsigned short)peerPort)) {
+			secondPlayer = &peer;
+		}
+		else {
+			cerr << "Could not listen for a network player on port " << peerPort << endl;
+		}
+	}
 
-	Text spaceBarText;
-	spaceBarText.setPosition(Vector2f(WINDOW_WIDTH / 2.0f - 300.0f, WINDOW_HEIGHT / 2.0f));
-	spaceBarText.setFont(spacefontloader);
-	spaceBarText.setString("Press space to play again\n  or press Esc for menu");
-	spaceBarText.setCharacterSize(10);
-	spaceBarText.setFillColor(Color::White);
-	
-	// backgrounds setup
-	sf::Texture bg2_texture;
-	if (!bg2_texture.loadFromFile("spacebg.png"))
-	{
-		exit(-1);
+	Replay recording;
+	if (recordFile != "") {
+		game.setRecording(&recording, recordFile);
 	}
-	Sprite backgroundMenu = Sprite(bg2_texture);
-	backgroundMenu.setPosition(0.0f, 0.0f);
+	Replay playback;
+	ReplayController replayLeft(&playback, -1);
+	ReplayController replayRight(&playback, 1);
 
-	sf::Texture bg_texture;
-	if (!bg_texture.loadFromFile("spacebg2.png"))
-	{
-		exit(-1);
+	// live capture drops frames rather than ever waiting on the disk
+	FrameCapture capture;
+	if (captureFile != "") {
+		capture.setMusic("pongdraft02.wav");
+		if (capture.open(captureFile, WINDOW_WIDTH, WINDOW_HEIGHT, CAPTURE_DROP)) {
+			game.setCapture(&capture);
+		}
+		else {
+			cerr << "Could not open " << captureFile << endl;
+		}
 	}
-	Sprite backgroundGame = Sprite(bg_texture);
-	backgroundGame.setPosition(0.0f, 0.0f);
 
-	// board setup
-	RectangleShape midLine(Vector2f(5.0f, WINDOW_HEIGHT));
-	midLine.setPosition(Vector2f(WINDOW_WIDTH / 2 - 2.5, 0));
-	midLine.setFillColor(Color(255, 255, 255, 255));
+	PlayingScene playingScene(&game);
+	MenuScene menuScene(&window, &game, &playingScene, spacefontloader, fontLoader, &assets.getTexture(menuBgId));
+	GameOverScene gameOverScene(&game, &playingScene, &menuScene, spacefontloader);
+	PausedScene pausedScene(&menuScene, spacefontloader);
+	playingScene.setScenes(&gameOverScene, &pausedScene);
 
-	// initialize game objects
-	Scoreboard scoreboard(Vector2f(WINDOW_WIDTH / 2, 20.0f));
-	
-	Ball ball1(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f)); 
-	ball1.setActive(true);
-	Ball ball2(Vector2f(-100.0f, 0), Vector2f(0.0f, 0.0f)); // extra balls created by powerups
-	Ball ball3(Vector2f(-100.0f, 0), Vector2f(0.0f, 0.0f));	// set pos and velocity to keep out of way
-	Ball balls[3] = {ball1, ball2, ball3}; // add all to array
+	// arena, player 1 is the human on the right hand controls and everyone else is AI
+	Arena arena(fontLoader);
+	AiController arenaAi[MAX_ARENA_PLAYERS];
+	arena.setController(0, humanRight);
+	for (int p = 1; p < MAX_ARENA_PLAYERS; p++) {
+		arena.setController(p, &arenaAi[p]);
+	}
+	ArenaScene arenaScene(&arena, &menuScene, &pausedScene, spacefontloader);
+	menuScene.setArena(&arena, &arenaScene);
+	menuScene.setMode(1, &aiLeft, humanRight);
+	menuScene.setMode(2, humanLeft, secondPlayer);
+	menuScene.setMode(3, &aiLeft, &aiRight);
 
-	Paddle paddleRight(Vector2f(WINDOW_WIDTH - 15.0f, WINDOW_HEIGHT / 2.0f - 35.0f)); // set up left and right paddles
-	Paddle paddleLeft(Vector2f(15.0, WINDOW_HEIGHT / 2.0f - 35.0f));				  // start in middle
+	SceneStack scenes;
+	if (replayFile != "" && playback.load(replayFile)) {
+		// go straight into the recorded match
+		game.setPlayback(&playback);
+		game.setControllers(&replayLeft, &replayRight);
+		scenes.push(&playingScene);
+	}
+	else {
+		if (replayFile != "") {
+			cerr << "Could not load replay " << replayFile << endl;
+		}
+		scenes.push(&menuScene);
+	}
 
-	PowerUp pu1(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT * 0.8f)); // place powerups
-	PowerUp pu2(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT * 0.2f));
+	// set up frame clock, capture has its own that keeps running through menus and pauses
+	Clock clock;
+	Clock captureClock;
+	float dt_ms = 0;
+	TargetCanvas windowCanvas(&window);
 	
 	/*
 	Main game loop begins here
 	*/
 	while (window.isOpen())
 	{
-		// frame timing for velocity and position modifications
-		dt_ms = clock.getElapsedTime().asMilliseconds();
-		clock.restart();
-		
-		// keep track of keyboard and click events
+		Scene* scene = scenes.top();
 		Event event;
-		while (window.pollEvent(event))
-		{
-			if (event.type == Event::Closed) {
-				music.stop(); // cut music on exit
-				window.close();
-			}
-			else if (event.type == Event::KeyPressed) {
-				if (event.key.code == Keyboard::Up) {
-					upKeyPressed = true;
-				}
-				else if (event.key.code == Keyboard::Down) {
-					downKeyPressed = true;
-				}
-				else if (event.key.code == Keyboard::W) {
-					wKeyPressed = true;
-				}
-				else if (event.key.code == Keyboard::S) {
-					sKeyPressed = true;
-				}
-				else if (event.key.code == Keyboard::Num1) {
-					if (!menuChosen) {
-						menuChoice = 1;
-						gameOver = false;
-					}
-				}
-				else if (event.key.code == Keyboard::Num2) {
-					if (!menuChosen) {
-						menuChoice = 2;
-						gameOver = false;
-					}
-				}
-				else if (event.key.code == Keyboard::Num3) {
-					if (!menuChosen) {
-						menuChoice = 3;
-						gameOver = false;
-					}
-				}
-				else if (event.key.code == Keyboard::Num4) {
-					if (!menuChosen) {
-						music.stop(); // cut music on exit
-						window.close();
-					}
-				}
-				else if (event.key.code == Keyboard::Space) {
-					if (menuChosen && gameOver) {
-						gameOver = false; // start new game, same settings
-						scoreboard.reset();
-					}
-				}
-				else if (event.key.code == Keyboard::Escape) {
-					if (menuChosen && gameOver) { // return to menu
-						menuChosen = false;
-						gameOver = false;
-						scoreboard.reset();
-					}
-				}
-			}
-			else if (event.type == Event::KeyReleased) {
-				if (event.key.code == Keyboard::Up) {
-					upKeyPressed = false;
-				}
-				else if (event.key.code == Keyboard::Down) {
-					downKeyPressed = false;
-				} 
-				else if (event.key.code == Keyboard::W) {
-					wKeyPressed = false;
-				}
-				else if (event.key.code == Keyboard::S) {
-					sKeyPressed = false;
-				}
-			}
-		}
-		
-		// if gameplay currently ongoing
-		if (menuChosen && !gameOver) {
-			// update movements of the paddles
-			for (int i = 0; i < 3; i++) { // track first found active ball
-				if (balls[i].isActive()) {
-					paddleRight.updateDelegator(dt_ms, downKeyPressed, upKeyPressed, balls[i].getPosition()); // player controls with (up) (down)
-					paddleLeft.updateDelegator(dt_ms, sKeyPressed, wKeyPressed, balls[i].getPosition()); // player controls with (w) (s)
-					break;
-				}
-			}
-
-			//update ball behavior for each ball in array
-			float ballsOnScreen = 0;
-			for (int i = 0; i < 3; i++) {
-				balls[i].update(dt_ms); // upate ball position (will set offscreen if offscreen)
-
-				// check paddle collisions
-				if (collisionRectangle(&balls[i], &paddleRight) && balls[i].isActive()) {
-					balls[i].bounce(paddleRight);
-					balls[i].setPosition(Vector2f(paddleRight.getPosition().x - balls[i].getRadius() - 1.0f, balls[i].getPosition().y));
-					sfx_impact.play();
-				}
-				else if (collisionRectangle(&balls[i], &paddleLeft) && balls[i].isActive()) {
-					balls[i].bounce(paddleLeft);
-					balls[i].setPosition(Vector2f(paddleLeft.getPosition().x + paddleLeft.getSize().x +
-						balls[i].getRadius() + 1.0f, balls[i].getPosition().y));
-					sfx_impact.play();
-				}
-
-				// check if ball hit powerup
-				if (!pu1.isCollected()) { // if pu1 still active
-					if (collisionCircle(balls[i].getPosition(), balls[i].getRadius(), pu1.getPosition(), pu1.getRadius())) {
-						pu1.collect(true); // remove on collision, create multiball
-						balls[1].setActive(true);
-						balls[1].setPosition(balls[i].getPosition());
-						balls[1].setVelocity(Vector2f(balls[i].getVelocity().x, -1.0f * balls[i].getVelocity().y));
-						sfx_powerup.play();
-					}
-				}
-				if (!pu2.isCollected()) { // if pu2 active
-					if (collisionCircle(balls[i].getPosition(), balls[i].getRadius(), pu2.getPosition(), pu2.getRadius())) {
-						pu2.collect(true); // remove on collision, create multiball
-						balls[2].setActive(true);
-						balls[2].setPosition(balls[i].getPosition());
-						balls[2].setVelocity(Vector2f(balls[i].getVelocity().x, -1.0f * balls[i].getVelocity().y));
-						sfx_powerup.play();
-					}
-				}
 
-				// keep track of how many balls on screen, scores
-				if (balls[i].isOffScreen() != 0 && balls[i].isActive()) { // if active ball off screen
-					balls[i].setActive(false);
-					balls[i].setVelocity(Vector2f(0.0f, 0.0f));
-					if (balls[i].isOffScreen() < 0) {
-						// off the left side
-						scoreboard.update(0, 1);
-					}
-					else { // off right side
-						scoreboard.update(1, 0);
-					}
+		// static scenes sleep until there is input instead of redrawing every frame, unless capture needs their frames
+		if (!scene->isAnimated() && !scenes.needsRedraw() && !capture.isOpen()) {
+			if (window.waitEvent(event)) {
+				if (event.type == Event::Closed) {
+					window.close();
 				}
-				else if (balls[i].isOffScreen() == 0 && balls[i].isActive()) { // active ball on screen
-					ballsOnScreen++;
+				else {
+					scenes.dispatch(event);
 				}
 			}
+			clock.restart(); // no time passes for the game while idle
+		}
 
-			// check if anyone won
-			if (scoreboard.getScores().x >= 5) {
-				gameOver = true;
-				gameOverText.setString("Left player wins");
-				gameOverText.setPosition(Vector2f(15.0f, WINDOW_HEIGHT - 30.0f));
-			}
-			else if (scoreboard.getScores().y >= 5) {
-				gameOver = true;
-				gameOverText.setString("Right player wins");
-				gameOverText.setPosition(Vector2f(WINDOW_WIDTH - 320.0f, WINDOW_HEIGHT - 30.0f));
+		// keep track of keyboard and click events
+		while (window.pollEvent(event))
+		{
+			if (event.type == Event::Closed) {
+				window.close();
 			}
 			else {
-				gameOverText.setString("");
-			}
-
-			// if no balls on screen, move main ball to center and start it
-			if (ballsOnScreen == 0) {
-				balls[0].setPosition(Vector2f(WINDOW_WIDTH / 2.0f, WINDOW_HEIGHT / 2.0f));
-				balls[0].randomizeStartVelocity();
-				balls[0].setActive(true);
-				pu1.collect(false);
-				pu2.collect(false);
+				scenes.dispatch(event);
 			}
+		}
+		if (!window.isOpen()) {
+			break;
+		}
 
-			// clear to black
-			window.clear(Color(0, 0, 0, 255));
-
-			// draw static board objects
-			window.draw(backgroundGame);
-			window.draw(midLine);
-
-			// draw updated game objects 
-			window.draw(gameOverText);
-			scoreboard.draw(&window);
-			paddleRight.draw(&window);
-			paddleLeft.draw(&window);
-
-			// draw all currently active balls
-			for (int i = 0; i < 3; i++) {
-				if (balls[i].isActive()) {
-					balls[i].draw(&window);
-				}
-			}
+		// frame timing for velocity and position modifications
+		dt_ms = clock.getElapsedTime().asMilliseconds();
+		clock.restart();
 
-			// draw all uncollected powerups
-			if (!pu1.isCollected()) {
-				pu1.draw(&window);
-			}
-			if (!pu2.isCollected()) {
-				pu2.draw(&window);
-			}
+		scene = scenes.top();
+		if (scene->isAnimated()) {
+			scene->update(dt_ms);
+			scene = scenes.top(); // update may have changed scenes
+		}
+		else if (!scenes.needsRedraw() && !capture.isOpen()) {
+			continue; // nothing changed on a static scene, go back to waiting
 		}
-		// if game is over but we are not on the menu
-		else if (menuChosen && gameOver) {
-			// clear to black
-			window.clear(Color(0, 0, 0, 255));
-			// draw static board objects
-			window.draw(backgroundGame);
-			window.draw(midLine);
 
-			// draw game objects 
-			window.draw(gameOverText);
-			window.draw(spaceBarText);
+		// clear to black, draw and display
+		window.clear(Color(0, 0, 0, 255));
+		scene->draw(&windowCanvas);
+		if (capture.isOpen()) {
+			capture.grabAt(captureClock.getElapsedTime().asMicroseconds());
+		}
+		window.display();
+		scenes.clearRedraw();
+	}
 
-			scoreboard.draw(&window);
-			paddleRight.draw(&window);
-			paddleLeft.draw(&window);
+	if (capture.isOpen()) {
+		Context context; // the window's context is gone, a shared one can still read the last pixel buffers
+		capture.close();
+		cout << capture.getFramesWritten() << " frames captured, " << capture.getFramesDropped() << " dropped" << endl;
+	}
 
-			// stop drawing balls and powerups but do reset for next game
-			ball1.setActive(true);
-			ball2.setActive(false);
-			ball3.setActive(false);
-			pu1.collect(false);
-			pu2.collect(false);
+	synth.stop();
+	if (synth.getBlocks() > 0) {
+		cout << "Audio thread: " << synth.getLoad() * 100.0f << "% busy, max " << synth.getMaxBlockUs() << " us per " <<
+			SYNTH_BLOCK_FRAMES << " sample block, " << synth.getUnderruns() << " underruns" << endl;
+	}
 
-			//return paddles to middle
-			paddleRight.setPosition(Vector2f(WINDOW_WIDTH - 15.0f, WINDOW_HEIGHT / 2.0f - 35.0f));
-			paddleLeft.setPosition(Vector2f(15.0, WINDOW_HEIGHT / 2.0f - 35.0f));
-		}
-		// if we are on the menu screen
-		else {
-			window.clear(Color(0, 0, 0, 255));
-			window.draw(backgroundMenu);
-			window.draw(titleTextShadow);
-			window.draw(titleText);
-			window.draw(menuTextShadow);
-			window.draw(menuText);
-
-			if (menuChoice != 0) { // user made selection
-				menuChosen = true; // take out of menu
-				if (menuChoice == 1) { // 1 player mode
-					paddleLeft.setAi(true);
-					paddleRight.setAi(false);
-				}
-				else if (menuChoice == 2) { // 2 player mode
-					paddleLeft.setAi(false);
-					paddleRight.setAi(false);
-				}
-				else if (menuChoice == 3) { // demo 
-					paddleLeft.setAi(true);
-					paddleRight.setAi(true);
-				}
-				menuChoice = 0; // reset
-			}
-		}
-		// display window in any case
-		window.display();
+	if (musicStarted) {
+		assets.getMusic(musicId)->stop(); // cut music on exit
 	}
 	return 0;
-}
\ No newline at end of file
+}